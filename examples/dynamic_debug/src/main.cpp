@@ -0,0 +1,102 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <Arduino.h>
+
+#include <logger.h>
+#include <log_callsite.h>
+
+
+auto logHandler = SerialLogHandler( /*color*/true, /*baudRate*/115200 );
+Logger rootLogger = Logger( /*tag*/"main", &logHandler );
+
+static String command;
+
+
+// ***************************************************************************
+//             HELPERS
+// ***************************************************************************
+
+static int readSensor(int channel)
+{
+    int value = analogRead(channel);
+    LOG_DYNAMIC_DEBUG(rootLogger, "sensor %d: raw value %d", channel, value);
+    return value;
+}
+
+static void executeCommand(const String& command)
+{
+    if (command == "list")
+    {
+        LogCallSites::forEach([](const LogCallSite& site) {
+            rootLogger.info("%s:%d %s \"%s\"", site.file, site.line,
+                site.state == LogCallSite::ENABLED ? "+p" : "-p", site.format);
+        });
+        return;
+    }
+    int count = LogCallSites::control(command.c_str());
+    if (count < 0)
+    {
+        rootLogger.error("Invalid command: %s", command.c_str());
+    }
+    else
+    {
+        rootLogger.info("%d call sites changed", count);
+    }
+}
+
+// ***************************************************************************
+//             SETUP
+// ***************************************************************************
+
+void setup()
+{
+    rootLogger.setLevel(Logger::LogLevel::INFO);
+
+    // enabled before the statement runs for the first time
+    LogCallSites::enable("main.cpp", 0, INT_MAX, "loop");
+
+    Serial.println("----------------------------------------------");
+    Serial.println("Finished startup");
+    Serial.println("----------------------------------------------");
+}
+
+
+// ***************************************************************************
+//              LOOP
+// ***************************************************************************
+
+static int counter = 0;
+
+void loop()
+{
+    int sum = 0;
+    for (int channel = 32; channel < 36; channel++)
+    {
+        sum += readSensor(channel);
+    }
+    LOG_DYNAMIC_DEBUG(rootLogger, "loop %d: sum %d", counter, sum);
+    rootLogger.info("Average sensor value %d", sum / 4);
+
+    while (Serial.available() > 0)
+    {
+        char c = Serial.read();
+        if (c == '\n' || c == '\r')
+        {
+            if (command.length() > 0)
+            {
+                executeCommand(command);
+            }
+            command = "";
+        }
+        else
+        {
+            command += c;
+        }
+    }
+
+    counter++;
+    delay(1000);
+}
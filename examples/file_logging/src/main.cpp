@@ -0,0 +1,77 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+
+#include <logger.h>
+#include <file_log_handler.h>
+#include <multi_log_handler.h>
+
+
+auto serialHandler = SerialLogHandler( /*color*/true, /*baudRate*/115200 );
+FileLogHandler* fileHandler = nullptr;
+auto multiLogHandler = MultiLogHandler();
+Logger rootLogger = Logger( /*tag*/"main", &multiLogHandler );
+Logger fileLogger = Logger( /*tag*/"bench", nullptr );
+
+
+// ***************************************************************************
+//             SETUP
+// ***************************************************************************
+
+void setup()
+{
+    delay(500);  // wait for serial interface to get up
+
+    if (!SPIFFS.begin(/*formatOnFail*/true))
+    {
+        Serial.println("Mounting SPIFFS failed");
+    }
+
+    fileHandler = new FileLogHandler( /*color*/false, "/spiffs/log.txt",
+        /*maxFileSize*/32*1024, /*keepFiles*/2, /*bufferSize*/4096 );
+    multiLogHandler.addLogHandler(&serialHandler);
+    multiLogHandler.addLogHandler(fileHandler);
+    fileLogger = Logger( /*tag*/"bench", fileHandler );
+
+    Serial.println("----------------------------------------------");
+    Serial.println("Finished startup");
+    Serial.println("----------------------------------------------");
+}
+
+
+// ***************************************************************************
+//              LOOP
+// ***************************************************************************
+
+static int counter = 0;
+
+void loop()
+{
+    // throughput of buffered lines, only the group commits hit the flash
+    const int LINES = 1000;
+    unsigned long droppedBefore = fileHandler->getDroppedCount();
+    unsigned long startTime = micros();
+    for (int i = 0; i < LINES; i++)
+    {
+        fileLogger.info("Benchmark line %d of round %d", i, counter);
+    }
+    fileHandler->flush();
+    unsigned long endTime = micros();
+    unsigned long dropped = fileHandler->getDroppedCount() - droppedBefore;
+    rootLogger.info("Buffered: %0.0f lines/s written, %lu lines dropped",
+        (LINES - dropped) * 1e6 / (endTime-startTime), dropped);
+
+    // a critical message returns after it has been synced to the flash
+    startTime = micros();
+    fileLogger.critical("Critical message %d", counter);
+    endTime = micros();
+    rootLogger.info("Critical with sync: %0.3f ms", (endTime-startTime)/1000.0);
+
+    counter++;
+    rootLogger.info("Sleeping a while...");
+    delay(5000);
+}
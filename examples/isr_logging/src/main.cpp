@@ -0,0 +1,71 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <Arduino.h>
+
+#include <logger.h>
+#include <isr_log.h>
+
+
+auto logHandler = SerialLogHandler( /*color*/true, /*baudRate*/115200 );
+Logger rootLogger = Logger( /*tag*/"main", &logHandler );
+Logger timerLogger = Logger( /*tag*/"timer", rootLogger );
+
+IsrLogBuffer timerLog( /*name*/"timer0", /*capacity*/64 );
+hw_timer_t* timer = nullptr;
+volatile uint32_t tickCount = 0;
+volatile uint32_t captureCycles = 0;
+
+
+// ***************************************************************************
+//             INTERRUPT HANDLER
+// ***************************************************************************
+
+void IRAM_ATTR onTimer()
+{
+    uint32_t count = tickCount++;
+    uint32_t startCycles = ESP.getCycleCount();
+    timerLog.log(timerLogger, Logger::LogLevel::DEBUG, "tick %u, level %d", count, digitalRead(0));
+    captureCycles = ESP.getCycleCount() - startCycles;
+}
+
+
+// ***************************************************************************
+//             SETUP
+// ***************************************************************************
+
+void setup()
+{
+    rootLogger.setLevel(Logger::LogLevel::DEBUG);
+
+    // 80 MHz / 80 = 1 MHz timer clock, interrupt every 10 ms
+    timer = timerBegin(0, 80, true);
+    timerAttachInterrupt(timer, &onTimer, true);
+    timerAlarmWrite(timer, 10000, true);
+    timerAlarmEnable(timer);
+
+    Serial.println("----------------------------------------------");
+    Serial.println("Finished startup");
+    Serial.println("----------------------------------------------");
+}
+
+
+// ***************************************************************************
+//              LOOP
+// ***************************************************************************
+
+static unsigned long lastReportMs = 0;
+
+void loop()
+{
+    timerLog.drain();
+
+    if (millis() - lastReportMs >= 5000)
+    {
+        lastReportMs = millis();
+        rootLogger.info("Capture took %u CPU cycles, %lu messages lost", captureCycles, timerLog.getOverrunCount());
+    }
+    delay(100);
+}
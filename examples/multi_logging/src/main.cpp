@@ -52,7 +52,9 @@ void setup()
     myHostname = String(id_buf);
     Serial.printf("Hostname: %s\n", myHostname.c_str());
 
-    multiLogHandler.addLogHandler(&syslogHandler);
+    // a stalled network must not delay the serial output
+    multiLogHandler.addAsyncLogHandler(&syslogHandler, /*queueLength*/32,
+        MultiLogHandler::DropPolicy::DROP_OLDEST);
     multiLogHandler.addLogHandler(&serialHandler);
     
     Serial.println("----------------------------------------------");
@@ -80,6 +82,10 @@ void loop()
     unsigned long endTime = micros();
     rootLogger.debug("Duration per call for 5 calls: %0.3f ms", (endTime-startTime)/5.0/1000.0);
 
+    auto stats = multiLogHandler.getStats(&syslogHandler);
+    rootLogger.info("Syslog queue: depth=%u max=%u written=%lu dropped=%lu",
+        stats.queueDepth, stats.maxQueueDepth, stats.written, stats.dropped);
+
     counter++;
     rootLogger.info("Sleeping a while...");
     delay(10*1000);
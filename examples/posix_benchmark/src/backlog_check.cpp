@@ -0,0 +1,294 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <logger.h>
+#include <log_backlog.h>
+
+
+Logger rootLogger = Logger( /*tag*/"main", nullptr );
+
+static std::string directory;
+static int failCount = 0;
+
+
+// ***************************************************************************
+//             HELPERS
+// ***************************************************************************
+
+static void expect(bool condition, const char* what)
+{
+    printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+    if (!condition)
+    {
+        failCount++;
+    }
+}
+
+static std::string pathOf(const char* name)
+{
+    return directory + "/" + name;
+}
+
+/**
+ * Message of record n, its length varies to move the ring boundaries.
+ */
+static std::string messageOf(int n)
+{
+    return std::to_string(n) + " " + std::string(n % 150, (char) ('a' + n % 26));
+}
+
+/**
+ * Pushes numbered records and checks what comes out of the backlog.
+ */
+class Tracker
+{
+public:
+    explicit Tracker(LogBacklog& backlog): _backlog(backlog) {}
+
+    void push(int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            std::string message = messageOf(pushed);
+            LogRecord record;
+            record.level = Logger::LogLevel::INFO;
+            record.tag = "tag";
+            record.task = pushed % 2 == 0 ? nullptr : "task";
+            record.ms = pushed;
+            record.time = 0;
+            record.message = message.c_str();
+            _backlog.push(record, 1000 + pushed);
+            pushed++;
+        }
+    }
+
+    void pop(int count)
+    {
+        BacklogEntry entry;
+        for (int i = 0; i < count && _backlog.pop(entry); i++)
+        {
+            int n = atoi(entry.message);
+            bool ok = n > last && n < pushed
+                && messageOf(n) == entry.message
+                && entry.record.ms == (unsigned long) n && entry.time == 1000 + n
+                && entry.record.tag != nullptr && strcmp(entry.record.tag, "tag") == 0
+                && (n % 2 == 0 ? entry.record.task == nullptr : strcmp(entry.record.task, "task") == 0);
+            bad += ok ? 0 : 1;
+            last = n;
+            popped++;
+        }
+        dropped += _backlog.takeDroppedCount();
+    }
+
+    void drain()
+    {
+        pop(1 << 30);
+    }
+
+    /**
+     * Every record came out in order and intact or was counted as dropped.
+     */
+    bool accounted() const
+    {
+        return bad == 0 && (unsigned long) pushed == popped + dropped;
+    }
+
+    int pushed = 0;
+    unsigned long popped = 0;
+    unsigned long dropped = 0;
+    int last = -1;
+    int bad = 0;
+
+private:
+    LogBacklog& _backlog;
+};
+
+/**
+ * Push and pop in an irregular pattern, so that the ring wraps and the
+ * spill file is written and read while it grows.
+ */
+static void runMixed(Tracker& tracker, int rounds)
+{
+    srand(1);
+    for (int round = 0; round < rounds; round++)
+    {
+        tracker.push(rand() % 100);
+        tracker.pop(rand() % 100);
+    }
+    tracker.drain();
+}
+
+
+// ***************************************************************************
+//             CHECKS
+// ***************************************************************************
+
+static void checkRing()
+{
+    LogBacklog backlog(2000);
+    Tracker tracker(backlog);
+    runMixed(tracker, 200);
+    printf("      %lu popped, %lu dropped\n", tracker.popped, tracker.dropped);
+    expect(tracker.accounted(), "RAM only: records in order or counted as dropped");
+    expect(tracker.last == tracker.pushed - 1, "RAM only: the newest record is kept");
+}
+
+static void checkSpill()
+{
+    std::string path = pathOf("spill.bin");
+    {
+        LogBacklog backlog(2000, path.c_str(), 1024*1024);
+        Tracker tracker(backlog);
+        runMixed(tracker, 200);
+        printf("      %lu popped, %lu dropped\n", tracker.popped, tracker.dropped);
+        expect(tracker.accounted() && tracker.dropped == 0, "large spill file: no record dropped");
+        expect(access(path.c_str(), F_OK) != 0, "spill file removed after replay");
+    }
+    {
+        LogBacklog backlog(2000, path.c_str(), 3000);
+        Tracker tracker(backlog);
+        runMixed(tracker, 200);
+        printf("      %lu popped, %lu dropped\n", tracker.popped, tracker.dropped);
+        expect(tracker.accounted() && tracker.dropped > 0, "small spill file: records in order or counted as dropped");
+    }
+}
+
+/**
+ * A spill file left over from a previous run is replayed, a partial
+ * record at its end is ignored.
+ */
+static void checkLeftover()
+{
+    std::string path = pathOf("leftover.bin");
+    int spilled;
+    {
+        LogBacklog backlog(1000, path.c_str(), 1024*1024);
+        Tracker tracker(backlog);
+        tracker.push(100);
+        // RAM contents are lost like in a reset, the spill file is left
+        spilled = tracker.pushed;
+    }
+    FILE* f = fopen(path.c_str(), "ab");
+    fwrite("\x05\x00\x00\x00\x00\x00\x00\x00\x14\x03\x00\x50", 1, 12, f);
+    fclose(f);
+
+    LogBacklog backlog(1000, path.c_str(), 1024*1024);
+    Tracker tracker(backlog);
+    tracker.pushed = spilled;
+    tracker.drain();
+    printf("      %lu replayed\n", tracker.popped);
+    expect(tracker.bad == 0 && tracker.popped > 0 && tracker.dropped == 1, "left-over records replayed in order, partial one dropped");
+
+    // new records after the replay, with a new spill file
+    int first = tracker.pushed;
+    tracker.push(100);
+    tracker.last = first - 1;
+    tracker.popped = 0;
+    tracker.dropped = 0;
+    tracker.drain();
+    expect(tracker.bad == 0 && tracker.popped + tracker.dropped == 100, "spilling works after a partial record");
+}
+
+/**
+ * The records of an unreadable spill file are counted as dropped.
+ */
+static void checkDamaged()
+{
+    std::string path = pathOf("damaged.bin");
+    {
+        LogBacklog backlog(1000, path.c_str(), 1024*1024);
+        Tracker tracker(backlog);
+        tracker.push(100);
+    }
+    // a message length beyond MESSAGE_BUFLEN in the second record
+    FILE* f = fopen(path.c_str(), "r+b");
+    uint8_t header[13];
+    fread(header, 1, sizeof(header), f);
+    long second = sizeof(header) + header[9] + header[10] + (header[11] | (header[12] << 8));
+    fseek(f, second + 11, SEEK_SET);
+    fwrite("\xff\xff", 1, 2, f);
+    fclose(f);
+
+    LogBacklog backlog(1000, path.c_str(), 1024*1024);
+    BacklogEntry entry;
+    unsigned long popped = 0;
+    while (backlog.pop(entry))
+    {
+        popped++;
+    }
+    unsigned long dropped = backlog.takeDroppedCount();
+    printf("      %lu popped, %lu dropped\n", popped, dropped);
+    expect(popped == 1 && dropped > 0, "records of a damaged spill file counted as dropped");
+}
+
+/**
+ * A short write (here: file size limit) leaves partial bytes, which are
+ * neither replayed nor followed by further records.
+ */
+static void checkShortWrite()
+{
+    std::string path = pathOf("short.bin");
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        signal(SIGXFSZ, SIG_IGN);
+        struct rlimit limit = { 3001, 3001 };
+        setrlimit(RLIMIT_FSIZE, &limit);
+        LogBacklog backlog(2000, path.c_str(), 1024*1024);
+        Tracker tracker(backlog);
+        tracker.push(200);
+        tracker.pop(10);
+        tracker.push(200);
+        tracker.drain();
+        // a second round after the file was removed
+        tracker.push(200);
+        tracker.drain();
+        // no output, the size limit applies to a redirected stdout as well
+        _exit(tracker.accounted() && tracker.dropped > 0 ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    expect(WIFEXITED(status) && WEXITSTATUS(status) == 0, "short spill write: no garbage replayed, losses counted");
+}
+
+
+// ***************************************************************************
+//             MAIN
+// ***************************************************************************
+
+int main()
+{
+    char tmpl[] = "/tmp/backlog_check.XXXXXX";
+    if (mkdtemp(tmpl) == nullptr)
+    {
+        perror("mkdtemp");
+        return 2;
+    }
+    directory = tmpl;
+
+    checkRing();
+    checkSpill();
+    checkLeftover();
+    checkDamaged();
+    checkShortWrite();
+
+    std::string command = "rm -rf " + directory;
+    if (system(command.c_str()) != 0)
+    {
+        printf("could not remove %s\n", directory.c_str());
+    }
+    return failCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,326 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <logger.h>
+#include <file_log_handler.h>
+
+
+Logger rootLogger = Logger( /*tag*/"main", nullptr );
+
+static std::string directory;
+static int failCount = 0;
+
+
+// ***************************************************************************
+//             HELPERS
+// ***************************************************************************
+
+static void expect(bool condition, const char* what)
+{
+    printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+    if (!condition)
+    {
+        failCount++;
+    }
+}
+
+static std::string pathOf(const char* name)
+{
+    return directory + "/" + name;
+}
+
+static bool exists(const std::string& path)
+{
+    return access(path.c_str(), F_OK) == 0;
+}
+
+/**
+ * Read a file via a separate stream, i.e. what another process would see.
+ */
+static std::string readFile(const std::string& path)
+{
+    std::string content;
+    FILE* f = fopen(path.c_str(), "r");
+    if (f != nullptr)
+    {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        {
+            content.append(buf, n);
+        }
+        fclose(f);
+    }
+    return content;
+}
+
+static size_t countLines(const std::string& path)
+{
+    std::string content = readFile(path);
+    size_t count = 0;
+    for (char c : content)
+    {
+        count += c == '\n' ? 1 : 0;
+    }
+    return count;
+}
+
+
+// ***************************************************************************
+//             CHECKS
+// ***************************************************************************
+
+/**
+ * A CRITICAL line is in the file when critical() returns, even while
+ * other threads keep both buffers full.
+ */
+static void checkCriticalDurable()
+{
+    std::string path = pathOf("critical.log");
+    auto handler = FileLogHandler( /*color*/false, path.c_str(),
+        /*maxFileSize*/64*1024*1024, /*keepFiles*/1, /*bufferSize*/1024, /*flushIntervalMs*/60000 );
+    Logger logger("check", &handler);
+    logger.setLevel(Logger::LogLevel::DEBUG);
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; t++)
+    {
+        producers.emplace_back([&logger, &stop]() {
+            for (int i = 0; !stop; i++)
+            {
+                logger.info("filler line %d to keep the buffers full", i);
+            }
+        });
+    }
+
+    int missing = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        char marker[64];
+        snprintf(marker, sizeof(marker), "critical marker %d", i);
+        logger.critical("%s", marker);
+        if (readFile(path).find(marker) == std::string::npos)
+        {
+            missing++;
+        }
+    }
+    stop = true;
+    for (auto& it : producers)
+    {
+        it.join();
+    }
+
+    printf("      %lu filler lines dropped meanwhile\n", handler.getDroppedCount());
+    expect(missing == 0, "CRITICAL lines are in the file when critical() returns");
+}
+
+/**
+ * Rotation keeps path plus exactly keepFiles old files.
+ */
+static void checkRotation()
+{
+    const int KEEP_FILES = 3;
+    std::string path = pathOf("rotate.log");
+    {
+        auto handler = FileLogHandler( /*color*/false, path.c_str(),
+            /*maxFileSize*/4096, KEEP_FILES, /*bufferSize*/1024 );
+        Logger logger("check", &handler);
+        for (int i = 0; i < 2000; i++)
+        {
+            logger.info("rotation line %d", i);
+            if (i % 20 == 0)
+            {
+                handler.flush();
+            }
+        }
+    }
+
+    bool allKept = exists(path);
+    bool sizesOk = true;
+    for (int i = 1; i <= KEEP_FILES; i++)
+    {
+        std::string rotated = path + "." + std::to_string(i);
+        allKept = allKept && exists(rotated);
+        sizesOk = sizesOk && readFile(rotated).size() <= 4096;
+    }
+    expect(allKept, "current file and keepFiles rotated files exist");
+    expect(!exists(path + "." + std::to_string(KEEP_FILES + 1)), "no more than keepFiles rotated files");
+    expect(sizesOk, "rotated files do not exceed maxFileSize");
+}
+
+/**
+ * A line below flushLevel reaches the file within flushIntervalMs.
+ */
+static void checkFlushInterval()
+{
+    const unsigned long INTERVAL_MS = 200;
+    std::string path = pathOf("interval.log");
+    auto handler = FileLogHandler( /*color*/false, path.c_str(),
+        /*maxFileSize*/64*1024, /*keepFiles*/1, /*bufferSize*/4096, INTERVAL_MS );
+    Logger logger("check", &handler);
+
+    auto startTime = std::chrono::steady_clock::now();
+    logger.info("interval marker");
+    long elapsedMs = -1;
+    while (elapsedMs < (long) INTERVAL_MS * 5)
+    {
+        long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+        if (readFile(path).find("interval marker") != std::string::npos)
+        {
+            elapsedMs = now;
+            break;
+        }
+        if (now > (long) INTERVAL_MS * 5)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    printf("      line visible after %ld ms\n", elapsedMs);
+    // allow some scheduling delay on top of the interval
+    expect(elapsedMs >= 0 && elapsedMs <= (long) INTERVAL_MS * 3 / 2, "INFO line is in the file within flushIntervalMs");
+}
+
+/**
+ * Throughput of the lines actually written, each line either written or counted as dropped.
+ */
+static void checkThroughput()
+{
+    const int THREADS = 4;
+    const int LINES = 100000;
+    std::string path = pathOf("throughput.log");
+    unsigned long dropped;
+    auto startTime = std::chrono::steady_clock::now();
+    {
+        auto handler = FileLogHandler( /*color*/false, path.c_str(),
+            /*maxFileSize*/256*1024*1024, /*keepFiles*/1, /*bufferSize*/256*1024 );
+        Logger logger("check", &handler);
+        std::vector<std::thread> producers;
+        for (int t = 0; t < THREADS; t++)
+        {
+            producers.emplace_back([&logger, t]() {
+                for (int i = 0; i < LINES; i++)
+                {
+                    logger.info("throughput line %d from %d", i, t);
+                }
+            });
+        }
+        for (auto& it : producers)
+        {
+            it.join();
+        }
+        handler.flush(/*sync*/true);
+        dropped = handler.getDroppedCount();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    size_t written = countLines(path);
+    printf("      %.0f lines/s written, %lu dropped\n", written / seconds, dropped);
+    expect(written + dropped == (size_t) THREADS * LINES, "every line is written or counted as dropped");
+}
+
+/**
+ * Lines are counted as dropped if the file cannot be opened, and flush()
+ * reports the failure.
+ */
+static void checkUnmounted()
+{
+    std::string path = pathOf("not_mounted/unmounted.log");
+    auto handler = FileLogHandler( /*color*/false, path.c_str() );
+    Logger logger("check", &handler);
+    for (int i = 0; i < 10; i++)
+    {
+        logger.info("line %d", i);
+    }
+    bool flushed = handler.flush(/*sync*/true);
+    expect(!flushed, "flush() reports the failure");
+    expect(handler.getDroppedCount() == 10, "lines counted as dropped if the file cannot be opened");
+    unsigned long errors = handler.getWriteErrorCount();
+    logger.critical("critical line");
+    expect(handler.getWriteErrorCount() > errors && handler.getDroppedCount() == 11,
+        "a failed CRITICAL line is counted");
+}
+
+/**
+ * Every line is in the file or counted as dropped, even after a short
+ * write (here: file size limit).
+ */
+static void checkShortWrite()
+{
+    const int LINES = 1000;
+    std::string path = pathOf("short.log");
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // no output, the size limit applies to a redirected stdout as well
+        signal(SIGXFSZ, SIG_IGN);
+        struct rlimit limit = { 10001, 10001 };
+        setrlimit(RLIMIT_FSIZE, &limit);
+        unsigned long dropped;
+        bool flushed;
+        {
+            auto handler = FileLogHandler( /*color*/false, path.c_str(),
+                /*maxFileSize*/1024*1024, /*keepFiles*/1, /*bufferSize*/64*1024 );
+            Logger logger("check", &handler);
+            for (int i = 0; i < LINES; i++)
+            {
+                logger.info("short write line %d", i);
+            }
+            flushed = handler.flush(/*sync*/true);
+            dropped = handler.getDroppedCount();
+        }
+        bool ok = !flushed && dropped > 0 && countLines(path) + dropped == LINES;
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    expect(WIFEXITED(status) && WEXITSTATUS(status) == 0, "short write: lines in the file or counted as dropped");
+}
+
+
+// ***************************************************************************
+//             MAIN
+// ***************************************************************************
+
+int main()
+{
+    char tmpl[] = "/tmp/file_check.XXXXXX";
+    if (mkdtemp(tmpl) == nullptr)
+    {
+        perror("mkdtemp");
+        return 2;
+    }
+    directory = tmpl;
+
+    checkCriticalDurable();
+    checkRotation();
+    checkFlushInterval();
+    checkThroughput();
+    checkUnmounted();
+    checkShortWrite();
+
+    std::string command = "rm -rf " + directory;
+    if (system(command.c_str()) != 0)
+    {
+        printf("could not remove %s\n", directory.c_str());
+    }
+    return failCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include <log_format.h>
+
+
+static unsigned long checkCount = 0;
+static unsigned long failCount = 0;
+
+
+// ***************************************************************************
+//             CONFORMANCE
+// ***************************************************************************
+
+static void compare(const char* function, const char* format, size_t size,
+    const char* expected, int expectedLen, const char* actual, int actualLen)
+{
+    checkCount++;
+    if (expectedLen != actualLen || strcmp(expected, actual) != 0)
+    {
+        if (failCount++ < 20)
+        {
+            printf("MISMATCH %s format \"%s\" size %zu: \"%s\" (%d) expected \"%s\" (%d)\n",
+                function, format, size, actual, actualLen, expected, expectedLen);
+        }
+    }
+}
+
+/**
+ * Compare logSnprintf() and logFormatArgs() with the C library for one
+ * format and argument, including the return value and truncation to a
+ * small buffer.
+ */
+template <typename T>
+static void check(const char* format, T value)
+{
+    for (size_t size : { (size_t) 256, (size_t) 5, (size_t) 1, (size_t) 0 })
+    {
+        char expected[256] = "";
+        char actual[256] = "";
+        int expectedLen = snprintf(size > 0 ? expected : nullptr, size, format, value);
+        int actualLen = logSnprintf(size > 0 ? actual : nullptr, size, format, value);
+        compare("logSnprintf", format, size, expected, expectedLen, actual, actualLen);
+
+        LogArg arg(value);
+        actualLen = logFormatArgs(size > 0 ? actual : nullptr, size, format, &arg, 1);
+        compare("logFormatArgs", format, size, expected, expectedLen, actual, actualLen);
+    }
+}
+
+static void checkConformance()
+{
+    static const char* const FLAGS[] = { "", "-", "0", "-0", "5", "-5", "05", "20", "-20", "020" };
+    static const int INTS[] = { 0, 1, -1, 9, 10, 99, 100, -100, 12345, 2147483647, -2147483647 - 1 };
+    static const long LONGS[] = { 0, -1, 4294967295L, 4294967296L, -4294967297L, 429496729600L, 1234567890123L, -9223372036854775807L - 1, 9223372036854775807L };
+    static const double DOUBLES[] = {
+        0.0, -0.0, 1.0, -1.5, 0.5, 2.5, 0.125, 2.675, 1.005, 0.05, 9.9999995, 999999.9999999,
+        3.14159265358979, -273.15, 1e-7, 123456789012345.0, 1e16, 1e300, -1e300, 1.0/0.0, -1.0/0.0, 0.0/0.0,
+    };
+    char format[32];
+
+    for (const char* flags : FLAGS)
+    {
+        for (const char* conversion : { "d", "i", "u", "x", "X" })
+        {
+            snprintf(format, sizeof(format), "<%%%s%s>", flags, conversion);
+            for (int value : INTS)
+            {
+                check(format, value);
+            }
+        }
+        for (const char* conversion : { "ld", "lu", "lx", "lld", "zu" })
+        {
+            snprintf(format, sizeof(format), "<%%%s%s>", flags, conversion);
+            for (long value : LONGS)
+            {
+                check(format, value);
+            }
+        }
+        for (const char* precision : { "", ".0", ".1", ".2", ".3", ".6", ".9", ".12" })
+        {
+            snprintf(format, sizeof(format), "<%%%s%sf>", flags, precision);
+            for (double value : DOUBLES)
+            {
+                check(format, value);
+            }
+        }
+        if (strchr(flags, '0') == nullptr)
+        {
+            for (const char* precision : { "", ".0", ".3", ".10" })
+            {
+                snprintf(format, sizeof(format), "<%%%s%ss>", flags, precision);
+                check(format, "hello world");
+                check(format, "");
+                check(format, (const char*) nullptr);
+            }
+            snprintf(format, sizeof(format), "<%%%sc>", flags);
+            check(format, 'x');
+        }
+    }
+    check("100%% %d%%", 42);
+    check("unsupported %p", (void*) format);
+    check("unsupported %+d", 42);
+    check("unsupported %5.3d", 42);
+    check("unsupported %g", 0.1);
+    check("unsupported %-+8.3e", -12345.678);
+    check("unsupported %hd", 70000);
+    check("unsupported %#hhx", 0x1234);
+    check("unsupported %lo", 4242L);
+    check("unsupported %y", 1);
+
+    // random values for the fast float path
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> magnitude(-6, 15);
+    for (int i = 0; i < 200000; i++)
+    {
+        double value = pow(10.0, magnitude(random)) * (random() & 1 ? -1 : 1);
+        snprintf(format, sizeof(format), "%%.%df", (int) (random() % 10));
+        check(format, value);
+    }
+    // binary fractions (e.g. sensor readings) hit exact ties
+    for (int i = 0; i < 100000; i++)
+    {
+        double value = (double) (int32_t) random() / 1024;
+        snprintf(format, sizeof(format), "%%.%df", (int) (random() % 5));
+        check(format, value);
+    }
+    for (int i = 0; i < 100000; i++)
+    {
+        check("%d", (int) random());
+        check("%lx", (long) random());
+    }
+}
+
+// ***************************************************************************
+//             BENCHMARK
+// ***************************************************************************
+
+typedef int (*FormatFunction)(char* buf, size_t size, const char* format, ...);
+
+static double measure(FormatFunction function, const char* format, int i, const char* str, double value)
+{
+    const int ITERATIONS = 1000000;
+    char buf[256];
+    volatile int sink = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    for (int n = 0; n < ITERATIONS; n++)
+    {
+        sink += function(buf, sizeof(buf), format, i + n, str, (unsigned) n * 2654435761u, value);
+    }
+    (void) sink;
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count() / ITERATIONS;
+}
+
+static void benchmark()
+{
+    static const char* const FORMATS[] = {
+        "Message %d from %s, value=%u",
+        "id=%05d name=%-10s mask=%08x",
+        "%d %s %x temperature %.2f",
+    };
+    for (const char* format : FORMATS)
+    {
+        double libc = measure(snprintf, format, 42, "producer", 21.375);
+        double fast = measure(logSnprintf, format, 42, "producer", 21.375);
+        printf("%-30s snprintf %6.1f ns, logSnprintf %6.1f ns\n", format, libc, fast);
+    }
+}
+
+// ***************************************************************************
+//             MAIN
+// ***************************************************************************
+
+int main()
+{
+    checkConformance();
+    printf("%lu of %lu checks passed\n", checkCount - failCount, checkCount);
+    benchmark();
+    return failCount == 0 ? 0 : 1;
+}
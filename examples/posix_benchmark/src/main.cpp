@@ -0,0 +1,268 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <logger.h>
+#include <fd_log_handler.h>
+#include <file_log_handler.h>
+#include <isr_log.h>
+#include <log_layout.h>
+#include <multi_log_handler.h>
+#include <syslog_handler.h>
+
+
+Logger rootLogger = Logger( /*tag*/"main", nullptr );
+
+static int threadCount = 4;
+static int messagesPerThread = 100000;
+
+
+// ***************************************************************************
+//             HELPERS
+// ***************************************************************************
+
+/**
+ * Log from threadCount threads via handler, return messages per second.
+ */
+static double runProducers(LogHandler* handler)
+{
+    Logger benchLogger("bench", handler);
+    benchLogger.setLevel(Logger::LogLevel::DEBUG);
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threadCount; t++)
+    {
+        producers.emplace_back([&benchLogger, t]() {
+            for (int i = 0; i < messagesPerThread; i++)
+            {
+                benchLogger.info("Message %d from producer %d, value=%u", i, t, i * 2654435761u);
+            }
+        });
+    }
+    for (auto& it : producers)
+    {
+        it.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return threadCount * messagesPerThread / seconds;
+}
+
+/**
+ * Render the line prefixes of the serial and the syslog layout with
+ * LogLayout and with the snprintf() calls they replaced.
+ */
+static void runLayouts()
+{
+    LogRecord record;
+    record.level = Logger::LogLevel::INFO;
+    record.tag = "bench";
+    record.task = "producer";
+    record.time = 0;
+    record.message = "";
+    LogLayout::Context context;
+    context.deviceId = "e32-a1b2c3d4e5f6";
+    context.colorStart = "";
+    context.colorEnd = "";
+    time(&context.time);
+    context.pri = 14;
+
+    const LogLayout serialLayout(LogHandler::DEFAULT_LAYOUT);
+    const LogLayout syslogLayout(SyslogHandler::DEFAULT_SYSLOG_LAYOUT);
+    char line[LogHandler::LINE_BUFLEN];
+    unsigned long total = 0;
+    double ns[4];
+    for (int variant = 0; variant < 4; variant++)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        for (int i = 0; i < messagesPerThread; i++)
+        {
+            unsigned long ms = 1000000 + i;
+            record.ms = ms;
+            if (variant == 0)
+            {
+                total += serialLayout.render(line, sizeof(line), record, context);
+            }
+            else if (variant == 1)
+            {
+                total += snprintf(line, sizeof(line), "%s%lu.%03lu:%02d:%s:%s:%s%s",
+                    context.colorStart, ms / 1000, ms % 1000, static_cast<int>(record.level),
+                    context.deviceId, record.tag, record.message, context.colorEnd);
+            }
+            else if (variant == 2)
+            {
+                total += syslogLayout.render(line, sizeof(line), record, context);
+            }
+            else
+            {
+                struct tm timeinfo;
+                gmtime_r(&context.time, &timeinfo);
+                char timeStr[64];
+                strftime(timeStr, sizeof(timeStr), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+                total += snprintf(line, sizeof(line), "<%d>1 %s %s %s %s %lu.%03lu %s%s%s",
+                    context.pri, timeStr, context.deviceId, record.tag, record.task,
+                    ms / 1000, ms % 1000, context.colorStart, record.message, context.colorEnd);
+            }
+        }
+        ns[variant] = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - startTime).count() / messagesPerThread;
+    }
+    rootLogger.info("LogLayout vs snprintf per prefix: serial %.1f ns vs %.1f ns, syslog %.1f ns vs %.1f ns (%lu chars)",
+        ns[0], ns[1], ns[2], ns[3], total);
+}
+
+/**
+ * Minimal syslog server counting the received datagrams.
+ */
+class UdpReceiver
+{
+public:
+    UdpReceiver(): _count(0), _stop(false)
+    {
+        _fd = socket(AF_INET, SOCK_DGRAM, 0);
+        int size = 8 * 1024 * 1024;
+        setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(_fd, (struct sockaddr*) &addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(_fd, (struct sockaddr*) &addr, &len);
+        _port = ntohs(addr.sin_port);
+        struct timeval tv = { 0, 100000 };
+        setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        _thread = std::thread([this]() {
+            char buf[512];
+            while (!_stop)
+            {
+                if (recv(_fd, buf, sizeof(buf), 0) > 0)
+                {
+                    _count++;
+                }
+            }
+        });
+    }
+
+    ~UdpReceiver()
+    {
+        _stop = true;
+        _thread.join();
+        close(_fd);
+    }
+
+    int port() const { return _port; }
+    unsigned long count() const { return _count; }
+
+private:
+    int _fd;
+    int _port;
+    std::atomic<unsigned long> _count;
+    std::atomic<bool> _stop;
+    std::thread _thread;
+};
+
+
+// ***************************************************************************
+//             MAIN
+// ***************************************************************************
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+    {
+        threadCount = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        messagesPerThread = atoi(argv[2]);
+    }
+
+    auto consoleHandler = FdLogHandler( /*color*/true, STDERR_FILENO );
+    rootLogger = Logger( /*tag*/"main", &consoleHandler );
+    rootLogger.info("%d producer threads with %d messages each", threadCount, messagesPerThread);
+
+    {
+        int fd = open("/dev/null", O_WRONLY);
+        auto handler = FdLogHandler( /*color*/false, fd );
+        rootLogger.info("FdLogHandler (/dev/null): %.0f messages/s", runProducers(&handler));
+        close(fd);
+    }
+
+    {
+        auto handler = FileLogHandler( /*color*/false, "posix_benchmark.log",
+            /*maxFileSize*/16*1024*1024, /*keepFiles*/1, /*bufferSize*/256*1024 );
+        double rate = runProducers(&handler);
+        handler.flush();
+        // only count the lines which actually made it into the file
+        double total = (double) threadCount * messagesPerThread;
+        unsigned long dropped = handler.getDroppedCount();
+        rootLogger.info("FileLogHandler: %.0f lines/s written, %lu dropped", rate * (total - dropped) / total, dropped);
+    }
+
+    for (bool block : { false, true })
+    {
+        UdpReceiver receiver;
+        unsigned long dropped;
+        double rate;
+        {
+            auto handler = SyslogHandler( /*color*/false, "127.0.0.1", receiver.port() );
+            handler.setSendQueue(/*maxPending*/4096, block);
+            rate = runProducers(&handler);
+            dropped = handler.getDroppedCount();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        // only count the datagrams which actually left the queue
+        double total = (double) threadCount * messagesPerThread;
+        rootLogger.info("SyslogHandler (sendmmsg, %s): %.0f messages/s sent, %lu dropped, %lu received",
+            block ? "blocking" : "dropping", rate * (total - dropped) / total, dropped, receiver.count());
+    }
+
+    {
+        int fd = open("/dev/null", O_WRONLY);
+        auto fdHandler = FdLogHandler( /*color*/false, fd );
+        auto multiHandler = MultiLogHandler();
+        multiHandler.addAsyncLogHandler(&fdHandler, /*queueLength*/1024,
+            MultiLogHandler::DropPolicy::BLOCK);
+        double rate = runProducers(&multiHandler);
+        rootLogger.info("MultiLogHandler (async, blocking): %.0f messages/s", rate);
+        // the worker may still write to fd
+        multiHandler.flush();
+        close(fd);
+    }
+
+    {
+        // capture only, as in an interrupt handler, then drain in one go
+        int fd = open("/dev/null", O_WRONLY);
+        auto handler = FdLogHandler( /*color*/false, fd );
+        Logger isrLogger("isr", &handler);
+        IsrLogBuffer isrLog("timer0", messagesPerThread);
+        auto startTime = std::chrono::steady_clock::now();
+        for (int i = 0; i < messagesPerThread; i++)
+        {
+            isrLog.log(isrLogger, Logger::LogLevel::INFO, "Tick %d, value=%u", i, i * 2654435761u);
+        }
+        double captureNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+        int drained = isrLog.drain();
+        rootLogger.info("IsrLogBuffer: %.1f ns per capture, %d drained, %lu overruns",
+            captureNs / messagesPerThread, drained, isrLog.getOverrunCount());
+        close(fd);
+    }
+
+    runLayouts();
+
+    return 0;
+}
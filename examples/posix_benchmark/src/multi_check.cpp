@@ -0,0 +1,250 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <logger.h>
+#include <multi_log_handler.h>
+
+
+Logger rootLogger = Logger( /*tag*/"main", nullptr );
+
+static int failCount = 0;
+
+
+// ***************************************************************************
+//             HELPERS
+// ***************************************************************************
+
+static void expect(bool condition, const char* what)
+{
+    printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+    if (!condition)
+    {
+        failCount++;
+    }
+}
+
+/**
+ * Child log handler keeping the messages it receives.
+ */
+class RecordingLogHandler: public LogHandler
+{
+public:
+    RecordingLogHandler(): LogHandler(false) {}
+
+    virtual void writeRecord(const LogRecord& record)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _messages.push_back(record.message);
+    }
+
+    std::vector<std::string> messages() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _messages;
+    }
+
+protected:
+    mutable std::mutex _mutex;
+    std::vector<std::string> _messages;
+};
+
+/**
+ * Child log handler whose writeRecord() blocks until it is released,
+ * like a SyslogHandler waiting for an unreachable network.
+ */
+class StallingLogHandler: public RecordingLogHandler
+{
+public:
+    StallingLogHandler(): _released(false), _entered(0) {}
+
+    virtual void writeRecord(const LogRecord& record)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _entered++;
+        _enteredCond.notify_all();
+        _releaseCond.wait(lock, [this]() { return _released; });
+        _messages.push_back(record.message);
+    }
+
+    /**
+     * Wait until a worker is blocked in writeRecord().
+     */
+    bool waitEntered(int count)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _enteredCond.wait_for(lock, std::chrono::seconds(5), [this, count]() { return _entered >= count; });
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _released = true;
+        _releaseCond.notify_all();
+    }
+
+private:
+    bool _released;
+    int _entered;
+    std::condition_variable _enteredCond;
+    std::condition_variable _releaseCond;
+};
+
+static std::vector<std::string> numbers(int first, int last)
+{
+    std::vector<std::string> result;
+    for (int i = first; i <= last; i++)
+    {
+        result.push_back(std::to_string(i));
+    }
+    return result;
+}
+
+
+// ***************************************************************************
+//             CHECKS
+// ***************************************************************************
+
+const int QUEUE_LENGTH = 8;
+const int MESSAGES = 100;
+const long MAX_LATENCY_US = 20000;
+
+/**
+ * A stalled asynchronous child neither delays the caller nor the
+ * synchronous child. The queue keeps QUEUE_LENGTH messages, the others
+ * are dropped according to the policy.
+ */
+static void checkDropPolicy(MultiLogHandler::DropPolicy policy, const char* name)
+{
+    printf("%s:\n", name);
+    RecordingLogHandler fast;
+    StallingLogHandler stalled;
+    MultiLogHandler* multi = new MultiLogHandler();
+    multi->addLogHandler(&fast);
+    multi->addAsyncLogHandler(&stalled, QUEUE_LENGTH, policy);
+    Logger logger("check", multi);
+
+    // the worker takes the first message and blocks, the others queue up
+    logger.info("%d", 0);
+    expect(stalled.waitEntered(1), "worker blocks in the stalled child");
+    long maxLatencyUs = 0;
+    for (int i = 1; i < MESSAGES; i++)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        logger.info("%d", i);
+        long latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+        maxLatencyUs = latencyUs > maxLatencyUs ? latencyUs : maxLatencyUs;
+    }
+    printf("      max caller latency %ld us\n", maxLatencyUs);
+    expect(maxLatencyUs < MAX_LATENCY_US, "caller latency stays bounded");
+    expect(fast.messages() == numbers(0, MESSAGES - 1), "synchronous child receives every record");
+
+    MultiLogHandler::SinkStats stats = multi->getStats(&stalled);
+    expect(stats.dropped == (unsigned long) (MESSAGES - 1 - QUEUE_LENGTH), "getStats() reports the dropped records");
+    expect(stats.queueDepth == QUEUE_LENGTH && stats.maxQueueDepth == QUEUE_LENGTH, "getStats() reports a full queue");
+
+    // the destructor drains the queue
+    stalled.release();
+    delete multi;
+    std::vector<std::string> expected = numbers(0, 0);
+    std::vector<std::string> kept = policy == MultiLogHandler::DropPolicy::DROP_NEWEST
+        ? numbers(1, QUEUE_LENGTH)
+        : numbers(MESSAGES - QUEUE_LENGTH, MESSAGES - 1);
+    expected.insert(expected.end(), kept.begin(), kept.end());
+    expect(stalled.messages() == expected, "stalled child receives the kept records in order");
+}
+
+/**
+ * With DropPolicy::BLOCK the caller waits for the stalled child and
+ * nothing is dropped.
+ */
+static void checkBlockPolicy()
+{
+    printf("BLOCK:\n");
+    RecordingLogHandler fast;
+    StallingLogHandler stalled;
+    MultiLogHandler* multi = new MultiLogHandler();
+    multi->addLogHandler(&fast);
+    multi->addAsyncLogHandler(&stalled, QUEUE_LENGTH, MultiLogHandler::DropPolicy::BLOCK);
+    Logger logger("check", multi);
+
+    std::thread producer([&logger]() {
+        for (int i = 0; i < MESSAGES; i++)
+        {
+            logger.info("%d", i);
+        }
+    });
+    expect(stalled.waitEntered(1), "worker blocks in the stalled child");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // one message in the child, a full queue and one message waiting for room
+    size_t fastCount = fast.messages().size();
+    printf("      %lu records passed while stalled\n", (unsigned long) fastCount);
+    expect(fastCount == QUEUE_LENGTH + 2, "caller blocks while the queue is full");
+
+    stalled.release();
+    producer.join();
+    MultiLogHandler::SinkStats stats = multi->getStats(&stalled);
+    expect(stats.dropped == 0, "getStats() reports no dropped records");
+    delete multi;
+    expect(fast.messages() == numbers(0, MESSAGES - 1), "synchronous child receives every record");
+    expect(stalled.messages() == numbers(0, MESSAGES - 1), "stalled child receives every record");
+}
+
+/**
+ * flush() returns after the queued records are written, also while
+ * the child is stalled when it is called.
+ */
+static void checkFlush()
+{
+    printf("flush():\n");
+    StallingLogHandler stalled;
+    MultiLogHandler multi;
+    multi.addAsyncLogHandler(&stalled, QUEUE_LENGTH, MultiLogHandler::DropPolicy::BLOCK);
+    Logger logger("check", &multi);
+
+    for (int i = 0; i < QUEUE_LENGTH; i++)
+    {
+        logger.info("%d", i);
+    }
+    expect(stalled.waitEntered(1), "worker blocks in the stalled child");
+    std::atomic<bool> flushed(false);
+    std::thread flusher([&multi, &flushed]() {
+        multi.flush();
+        flushed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    expect(!flushed, "flush() waits for the stalled child");
+
+    stalled.release();
+    flusher.join();
+    expect(stalled.messages() == numbers(0, QUEUE_LENGTH - 1), "flush() returns after every record is written");
+    MultiLogHandler::SinkStats stats = multi.getStats(&stalled);
+    expect(stats.queueDepth == 0 && stats.written == QUEUE_LENGTH, "getStats() reports an empty queue");
+}
+
+
+// ***************************************************************************
+//             MAIN
+// ***************************************************************************
+
+int main()
+{
+    checkDropPolicy(MultiLogHandler::DropPolicy::DROP_NEWEST, "DROP_NEWEST");
+    checkDropPolicy(MultiLogHandler::DropPolicy::DROP_OLDEST, "DROP_OLDEST");
+    checkBlockPolicy();
+    checkFlush();
+    return failCount == 0 ? 0 : 1;
+}
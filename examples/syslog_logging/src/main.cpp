@@ -77,5 +77,10 @@ void loop()
 
     counter++;
     rootLogger.info("Sleeping a while...");
-    delay(10*1000);
+    for (int i = 0; i < 100; i++)
+    {
+        // replay messages logged while WiFi was down
+        logHandler.flushBacklog();
+        delay(100);
+    }
 }
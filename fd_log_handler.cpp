@@ -0,0 +1,39 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include "fd_log_handler.h"
+
+#ifdef LOGGER32_POSIX
+
+#include <cerrno>
+#include <sys/uio.h>
+
+
+// ***************************************************************************
+
+FdLogHandler::FdLogHandler(bool color, int fd):
+    LogHandler(color),
+    _fd(fd)
+{
+}
+
+void FdLogHandler::writeRecord(const LogRecord& record)
+{
+    char line[LINE_BUFLEN];
+    int len = formatLine(line, LINE_BUFLEN, record);
+
+    struct iovec iov[2];
+    iov[0].iov_base = line;
+    iov[0].iov_len = len;
+    iov[1].iov_base = const_cast<char*>("\n");
+    iov[1].iov_len = 1;
+    while (writev(_fd, iov, 2) < 0 && errno == EINTR)
+    {
+    }
+}
+
+// ***************************************************************************
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include "logger.h"
+
+
+// ***************************************************************************
+
+#ifdef LOGGER32_POSIX
+
+/**
+ * Concrete LogHandler for a POSIX file descriptor (e.g. stdout)
+ *
+ * The default layout is the same as for the SerialLogHandler. Each line
+ * is written with a single writev() call, so lines from concurrent
+ * threads do not interleave on pipes and terminals.
+ */
+class FdLogHandler: public LogHandler
+{
+public:
+    /**
+     * Construct a FdLogHandler
+     * @param color  If `true`, use ANSI colors in the log output.
+     * @param fd  File descriptor to write to, default is stdout.
+     */
+    FdLogHandler(bool color = true, int fd = 1);
+
+    virtual void writeRecord(const LogRecord& record);
+
+private:
+    int _fd;
+};
+
+#endif
+
+// ***************************************************************************
@@ -0,0 +1,248 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+
+#include "file_log_handler.h"
+
+
+// ***************************************************************************
+
+FileLogHandler::FileLogHandler(bool color, const char* path,
+        size_t maxFileSize, int keepFiles,
+        size_t bufferSize, unsigned long flushIntervalMs,
+        Logger::LogLevel flushLevel):
+    LogHandler(color),
+    _path(path),
+    _maxFileSize(maxFileSize),
+    _keepFiles(keepFiles),
+    _bufferSize(bufferSize),
+    _flushIntervalMs(flushIntervalMs),
+    _flushLevel(flushLevel),
+    _file(nullptr),
+    _fileSize(0),
+    _activeBuffer(new char[bufferSize]),
+    _activeLen(0),
+    _writeBuffer(new char[bufferSize]),
+    _flushRequested(false),
+    _syncPending(false),
+    _stop(false),
+    _flushTicket(0),
+    _flushDone(0),
+    _droppedCount(0),
+    _writeErrorCount(0)
+{
+    _writer = startWorker("filelog", 4096, [this]() { writerLoop(); });
+}
+
+FileLogHandler::~FileLogHandler()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _writerCond.notify_one();
+    if (_writer.joinable())
+    {
+        _writer.join();
+    }
+    if (_file != nullptr)
+    {
+        fclose(_file);
+    }
+}
+
+void FileLogHandler::writeRecord(const LogRecord& record)
+{
+    Logger::LogLevel level = record.level;
+
+    // format the line outside of the lock
+    char line[LINE_BUFLEN];
+    int len = formatLine(line, LINE_BUFLEN-1, record);
+    line[len++] = '\n';
+
+    unsigned long writeErrorCount;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        writeErrorCount = _writeErrorCount;
+        if (_activeLen + len > _bufferSize && level >= _flushLevel && (size_t) len <= _bufferSize)
+        {
+            // important lines wait for the writer to take over the full buffer
+            _flushRequested = true;
+            _writerCond.notify_one();
+            _spaceCond.wait(lock, [this, len]() { return _activeLen + len <= _bufferSize || _stop; });
+        }
+        if (_activeLen + len > _bufferSize)
+        {
+            // the writer is still busy with the other buffer
+            _droppedCount++;
+        }
+        else
+        {
+            memcpy(&_activeBuffer[_activeLen], line, len);
+            _activeLen += len;
+        }
+        if (_activeLen >= _bufferSize / 2 || level >= _flushLevel)
+        {
+            _flushRequested = true;
+            _writerCond.notify_one();
+        }
+    }
+
+    if (level >= Logger::LogLevel::CRITICAL)
+    {
+        // a failure is counted in getWriteErrorCount()
+        waitFlushed(/*sync*/true, writeErrorCount);
+    }
+}
+
+bool FileLogHandler::flush(bool sync)
+{
+    return waitFlushed(sync, _writeErrorCount);
+}
+
+/**
+ * Flush and return `false` if writing failed since writeErrorCount was taken.
+ */
+bool FileLogHandler::waitFlushed(bool sync, unsigned long writeErrorCount)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    uint32_t ticket = ++_flushTicket;
+    _syncPending = _syncPending || sync;
+    _writerCond.notify_one();
+    // a wrapped around ticket counter results in a spurious early return only
+    _syncCond.wait(lock, [this, ticket]() { return (int32_t) (_flushDone - ticket) >= 0 || _stop; });
+    return _writeErrorCount == writeErrorCount;
+}
+
+void FileLogHandler::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _writerCond.wait_for(lock, std::chrono::milliseconds(_flushIntervalMs), [this]() {
+            return _flushRequested || _flushTicket != _flushDone || _stop;
+        });
+
+        // take over the active buffer, callers continue with the other one
+        uint32_t ticket = _flushTicket;
+        bool sync = _syncPending || _stop;
+        bool stop = _stop;
+        size_t len = _activeLen;
+        std::swap(_activeBuffer, _writeBuffer);
+        _activeLen = 0;
+        _flushRequested = false;
+        _syncPending = false;
+        _spaceCond.notify_all();
+
+        lock.unlock();
+        bool ok = writeBuffer(_writeBuffer.get(), len, sync);
+        lock.lock();
+
+        // counted under the lock, so that a flush() waiting for this ticket sees it
+        if (!ok)
+        {
+            _writeErrorCount++;
+        }
+
+        _flushDone = ticket;
+        _syncCond.notify_all();
+        if (stop)
+        {
+            break;
+        }
+    }
+}
+
+bool FileLogHandler::writeBuffer(const char* data, size_t len, bool sync)
+{
+    if (len == 0 && !sync)
+    {
+        return true;
+    }
+    if (_file == nullptr)
+    {
+        openFile();
+    }
+    if (_file != nullptr && _fileSize > 0 && _fileSize + len > _maxFileSize)
+    {
+        rotate();
+    }
+    if (_file == nullptr)
+    {
+        // e.g. the file system is not mounted
+        dropLines(data, len);
+        return false;
+    }
+
+    // the file is unbuffered, so written is what reached the file system
+    size_t written = fwrite(data, 1, len, _file);
+    _fileSize += written;
+    if (written < len)
+    {
+        // a partially written line counts as dropped, too; reopen next time
+        dropLines(data + written, len - written);
+        fclose(_file);
+        _file = nullptr;
+        return false;
+    }
+    return !sync || fsync(fileno(_file)) == 0;
+}
+
+/**
+ * Count the lines in data as dropped.
+ */
+void FileLogHandler::dropLines(const char* data, size_t len)
+{
+    _droppedCount += std::count(data, data + len, '\n');
+}
+
+void FileLogHandler::openFile()
+{
+    _file = fopen(_path.c_str(), "a");
+    _fileSize = 0;
+    if (_file != nullptr)
+    {
+        // whole buffers are written at once, a stdio buffer would only hide errors
+        setvbuf(_file, nullptr, _IONBF, 0);
+    }
+    if (_file != nullptr && fseek(_file, 0, SEEK_END) == 0)
+    {
+        long pos = ftell(_file);
+        _fileSize = pos > 0 ? pos : 0;
+    }
+}
+
+void FileLogHandler::rotate()
+{
+    fclose(_file);
+    _file = nullptr;
+
+    if (_keepFiles > 0)
+    {
+        // path.(n-1) -> path.n, ..., path -> path.1
+        std::string oldest = _path + "." + std::to_string(_keepFiles);
+        remove(oldest.c_str());
+        for (int i = _keepFiles-1; i >= 1; i--)
+        {
+            std::string from = _path + "." + std::to_string(i);
+            std::string to = _path + "." + std::to_string(i+1);
+            rename(from.c_str(), to.c_str());
+        }
+        std::string first = _path + ".1";
+        rename(_path.c_str(), first.c_str());
+    }
+    else
+    {
+        remove(_path.c_str());
+    }
+
+    openFile();
+}
+
+// ***************************************************************************
@@ -0,0 +1,122 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "logger.h"
+
+
+// ***************************************************************************
+
+/**
+ * Concrete LogHandler writing to a file with size based rotation
+ *
+ * Log lines are collected in a RAM buffer and written by a background
+ * thread in one go (group commit). The buffer is handed to the writer
+ * when it is half full, when flushInterval has passed, or when a
+ * message with at least flushLevel arrives. CRITICAL messages are
+ * synced to the storage before critical() returns.
+ *
+ * The file is accessed via stdio, so any path handled by the C library
+ * works: on the ESP32, mount LittleFS, SPIFFS or an SD card via the VFS
+ * (e.g. "/littlefs/log.txt"), on a host use any regular file.
+ *
+ * When the file would exceed maxFileSize, it is renamed to `path.1`
+ * (`path.1` to `path.2` and so on, keeping keepFiles old files) by the
+ * writer thread. While the writer is busy, new lines go to the second
+ * buffer. If that one overflows too, lines below flushLevel are dropped
+ * and counted instead of stalling the caller; lines with flushLevel and
+ * above wait for the writer.
+ *
+ * Lines which cannot be written (file system not mounted, storage full)
+ * are counted as dropped as well, so every line is either in the file
+ * or in getDroppedCount(). Failed writes and syncs are also counted in
+ * getWriteErrorCount() and make flush() return `false`.
+ */
+class FileLogHandler: public LogHandler
+{
+public:
+    /**
+     * Construct a FileLogHandler
+     * @param color  If `true`, use ANSI colors in the log output.
+     * @param path  Path of the log file.
+     * @param maxFileSize  Rotate the log file before it exceeds this size (bytes).
+     * @param keepFiles  Number of rotated files to keep (0: truncate instead).
+     * @param bufferSize  Size of each of the two RAM buffers (bytes).
+     * @param flushIntervalMs  Maximum time a line stays in the RAM buffer.
+     * @param flushLevel  Messages with this level or above trigger a flush.
+     */
+    FileLogHandler(bool color, const char* path,
+        size_t maxFileSize = 64*1024, int keepFiles = 3,
+        size_t bufferSize = 4096, unsigned long flushIntervalMs = 1000,
+        Logger::LogLevel flushLevel = Logger::LogLevel::ERROR);
+    virtual ~FileLogHandler();
+
+    virtual void writeRecord(const LogRecord& record);
+
+    /**
+     * Write all buffered lines to the file.
+     * @param sync  If `true`, also sync the file to the storage.
+     *              Blocks until the data has been written.
+     * @return `false` if writing (or syncing) failed meanwhile.
+     */
+    bool flush(bool sync = false);
+
+    /**
+     * Number of lines dropped because both buffers were full or writing failed.
+     */
+    unsigned long getDroppedCount() const { return _droppedCount.load(); }
+
+    /**
+     * Number of failed writes and syncs, e.g. for CRITICAL lines, whose
+     * sync cannot be reported to the caller of critical().
+     */
+    unsigned long getWriteErrorCount() const { return _writeErrorCount.load(); }
+
+private:
+    bool waitFlushed(bool sync, unsigned long writeErrorCount);
+    void writerLoop();
+    bool writeBuffer(const char* data, size_t len, bool sync);
+    void dropLines(const char* data, size_t len);
+    void openFile();
+    void rotate();
+
+    std::string _path;
+    size_t _maxFileSize;
+    int _keepFiles;
+    size_t _bufferSize;
+    unsigned long _flushIntervalMs;
+    Logger::LogLevel _flushLevel;
+
+    FILE* _file;
+    size_t _fileSize;
+
+    std::unique_ptr<char[]> _activeBuffer;
+    size_t _activeLen;
+    std::unique_ptr<char[]> _writeBuffer;
+
+    std::mutex _mutex;
+    std::condition_variable _writerCond;
+    std::condition_variable _syncCond;
+    std::condition_variable _spaceCond;
+    bool _flushRequested;
+    bool _syncPending;
+    bool _stop;
+    uint32_t _flushTicket;
+    uint32_t _flushDone;
+    std::atomic<unsigned long> _droppedCount;
+    std::atomic<unsigned long> _writeErrorCount;
+    std::thread _writer;
+};
+
+// ***************************************************************************
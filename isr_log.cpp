@@ -0,0 +1,78 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include "isr_log.h"
+
+
+// ***************************************************************************
+
+IsrLogBuffer::IsrLogBuffer(const char* name, size_t capacity):
+    _name(name),
+    _msOffset(0),
+    _entries(nullptr),
+    _mask(0),
+    _head(0),
+    _tail(0),
+    _overrunCount(0)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    _entries = new Entry[size];
+    _mask = size - 1;
+
+    #ifdef ESP_PLATFORM
+    // the tick count starts with the scheduler, uptimeMs() at boot
+    _msOffset = LogHandler::uptimeMs() - xTaskGetTickCount() * portTICK_PERIOD_MS;
+    #endif
+}
+
+IsrLogBuffer::~IsrLogBuffer()
+{
+    delete[] _entries;
+}
+
+int IsrLogBuffer::drain(int maxCount)
+{
+    int count = 0;
+    uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+    while (count < maxCount && tail != __atomic_load_n(&_head, __ATOMIC_ACQUIRE))
+    {
+        // copy the entry to hand its slot back to the producer before the output
+        Entry entry = _entries[tail & _mask];
+        __atomic_store_n(&_tail, ++tail, __ATOMIC_RELEASE);
+        write(entry);
+        count++;
+    }
+    return count;
+}
+
+void IsrLogBuffer::write(const Entry& entry)
+{
+    LogHandler* handler = entry.logger->getLogHandler();
+    if (handler == nullptr || entry.level < entry.logger->getLevel())
+    {
+        return;
+    }
+
+    char message[LogHandler::MESSAGE_BUFLEN];
+    logFormatArgs(message, sizeof(message), entry.format, entry.args, entry.argCount);
+
+    LogRecord record;
+    record.level = entry.level;
+    record.tag = entry.logger->getTag();
+    record.task = _name;
+    record.ms = entry.ms + _msOffset;
+    // no wall clock in the ISR, go back from now by the age of the entry
+    long ageMs = (long) (LogHandler::uptimeMs() - record.ms);
+    time(&record.time);
+    record.time -= ageMs > 0 ? ageMs / 1000 : 0;
+    record.message = message;
+    handler->writeRecord(record);
+}
+
+// ***************************************************************************
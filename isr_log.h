@@ -0,0 +1,146 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <type_traits>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+#include "logger.h"
+#include "log_format.h"  // LOGGER32_ISR_INLINE, LogArg
+
+
+// ***************************************************************************
+
+/**
+ * Log buffer for one interrupt context
+ *
+ * Logger methods must not be called from interrupt handlers, because
+ * the LogHandlers format with the C library, use locks and do I/O.
+ * Instead, an interrupt handler captures the Logger, level, format
+ * pointer and up to MAX_ARGS integer or pointer arguments into an
+ * IsrLogBuffer. The capture takes a few dozen instructions, it neither
+ * blocks nor allocates. A task calls drain() regularly (e.g. from loop()) to format
+ * the messages and write them to the Logger's LogHandler with their
+ * original timestamp.
+ *
+ * The buffer is a wait-free ring for a single producer (one interrupt
+ * handler or one timer callback task) and a single consumer (the task
+ * calling drain()). Use one IsrLogBuffer per interrupt context. If the
+ * ring is full, the message is dropped and counted.
+ *
+ * The format and string arguments are kept as pointers, so they must
+ * still be valid when the message is drained (e.g. string literals).
+ * The Logger's level is applied when draining.
+ *
+ * Example:
+ * ```
+ * IsrLogBuffer isrLog("timer0");
+ * void IRAM_ATTR onTimer() { isrLog.log(rootLogger, Logger::LogLevel::DEBUG, "tick %u", ticks++); }
+ * void loop() { isrLog.drain(); }
+ * ```
+ */
+class IsrLogBuffer
+{
+public:
+    static constexpr int MAX_ARGS = 4;
+
+    /**
+     * Construct an IsrLogBuffer (not from an interrupt handler).
+     * @param name  Name of the interrupt context, written as task name.
+     * @param capacity  Number of messages, rounded up to a power of 2.
+     */
+    explicit IsrLogBuffer(const char* name = "isr", size_t capacity = 32);
+    ~IsrLogBuffer();
+    IsrLogBuffer(const IsrLogBuffer&) = delete;
+    IsrLogBuffer& operator=(const IsrLogBuffer&) = delete;
+
+    /**
+     * Capture a message, safe to call from the interrupt context.
+     * @param args  Up to MAX_ARGS integers, enums or pointers. Floating
+     *              point is rejected, the ESP32 must not use the FPU in
+     *              interrupt handlers; log scaled integers instead.
+     */
+    template <typename... Args>
+    LOGGER32_ISR_INLINE void log(const Logger& logger, Logger::LogLevel level, const char* format, Args... args)
+    {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many arguments for IsrLogBuffer::log()");
+        static_assert(!AnyFloatingPoint<Args...>::value, "no floating point arguments for IsrLogBuffer::log()");
+        uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+        if (head - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE) > _mask)
+        {
+            // only the producer writes the counter
+            __atomic_store_n(&_overrunCount, _overrunCount + 1, __ATOMIC_RELAXED);
+            return;
+        }
+
+        Entry& entry = _entries[head & _mask];
+        entry.logger = &logger;
+        entry.format = format;
+        #ifdef ESP_PLATFORM
+        // ISR safe and cheaper than millis(), the difference is added in drain()
+        entry.ms = xTaskGetTickCountFromISR() * portTICK_PERIOD_MS;
+        #else
+        entry.ms = LogHandler::uptimeMs();
+        #endif
+        entry.level = level;
+        entry.argCount = sizeof...(Args);
+        const LogArg values[sizeof...(Args) + 1] = { LogArg(args)... };
+        for (size_t i = 0; i < sizeof...(Args); i++)
+        {
+            entry.args[i] = values[i];
+        }
+        __atomic_store_n(&_head, head + 1, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * Format and write the captured messages (from a single task).
+     * @param maxCount  Maximum number of messages to write.
+     * @return Number of messages taken from the buffer.
+     */
+    int drain(int maxCount = INT_MAX);
+
+    /**
+     * Number of messages dropped because the buffer was full.
+     */
+    unsigned long getOverrunCount() const { return __atomic_load_n(&_overrunCount, __ATOMIC_RELAXED); }
+
+private:
+    template <typename... Args>
+    struct AnyFloatingPoint: std::false_type {};
+    template <typename T, typename... Rest>
+    struct AnyFloatingPoint<T, Rest...>: std::integral_constant<bool,
+        std::is_floating_point<T>::value || AnyFloatingPoint<Rest...>::value> {};
+
+    struct Entry
+    {
+        const Logger* logger;
+        const char* format;
+        unsigned long ms;
+        Logger::LogLevel level;
+        int argCount;
+        LogArg args[MAX_ARGS];
+    };
+
+    void write(const Entry& entry);
+
+    const char* _name;
+    unsigned long _msOffset;
+    Entry* _entries;
+    uint32_t _mask;
+    // accessed with the __atomic builtins, which are inlined at any
+    // optimization level unlike the std::atomic members
+    uint32_t _head;
+    uint32_t _tail;
+    unsigned long _overrunCount;
+};
+
+// ***************************************************************************
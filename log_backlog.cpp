@@ -0,0 +1,352 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "log_backlog.h"
+
+
+// ***************************************************************************
+
+namespace {
+
+// header: ms (4), time (4), level (1), tag length (1), task length (1), message length (2)
+
+void encodeHeader(uint8_t* h, uint32_t ms, uint32_t time, uint8_t level,
+    uint8_t tagLen, uint8_t taskLen, uint16_t msgLen)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        h[i] = (uint8_t) (ms >> (8*i));
+        h[4+i] = (uint8_t) (time >> (8*i));
+    }
+    h[8] = level;
+    h[9] = tagLen;
+    h[10] = taskLen;
+    h[11] = (uint8_t) msgLen;
+    h[12] = (uint8_t) (msgLen >> 8);
+}
+
+uint32_t decodeU32(const uint8_t* p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+size_t copyLength(const char* str, size_t maxLen)
+{
+    return str == nullptr ? 0 : strnlen(str, maxLen);
+}
+
+/**
+ * Point the record in entry to the entry's strings after they are filled in.
+ */
+void finishEntry(BacklogEntry& entry, const uint8_t* h)
+{
+    entry.record.ms = decodeU32(&h[0]);
+    entry.time = (time_t) decodeU32(&h[4]);
+    entry.record.time = entry.time;
+    entry.record.level = static_cast<Logger::LogLevel>(h[8]);
+    entry.tag[h[9]] = '\0';
+    entry.task[h[10]] = '\0';
+    entry.message[h[11] | (h[12] << 8)] = '\0';
+    entry.record.tag = h[9] == 0 ? nullptr : entry.tag;
+    entry.record.task = h[10] == 0 ? nullptr : entry.task;
+    entry.record.message = entry.message;
+}
+
+}
+
+// ***************************************************************************
+
+LogBacklog::LogBacklog(size_t capacity, const char* spillPath, size_t spillMaxSize):
+    _buffer(capacity > 0 ? new uint8_t[capacity] : nullptr),
+    _capacity(capacity),
+    _head(0),
+    _tail(0),
+    _used(0),
+    _spillPath(spillPath == nullptr ? "" : spillPath),
+    _spillMaxSize(spillPath == nullptr ? 0 : spillMaxSize),
+    _spillSize(0),
+    _spillReadPos(0),
+    _spillRecords(0),
+    _spillAppendable(true),
+    _spillBuffer(_spillMaxSize > 0 ? new uint8_t[SPILL_READ_SIZE] : nullptr),
+    _spillBufferPos(0),
+    _spillBufferLen(0),
+    _droppedCount(0)
+{
+    if (_spillMaxSize > 0)
+    {
+        // replay what is left over from a previous run
+        scanSpill();
+    }
+}
+
+void LogBacklog::push(const LogRecord& record, time_t time)
+{
+    uint8_t tagLen = copyLength(record.tag, sizeof(BacklogEntry::tag) - 1);
+    uint8_t taskLen = copyLength(record.task, sizeof(BacklogEntry::task) - 1);
+    uint16_t msgLen = copyLength(record.message, sizeof(BacklogEntry::message) - 1);
+    size_t size = HEADER_SIZE + tagLen + taskLen + msgLen;
+    if (size > _capacity)
+    {
+        _droppedCount++;
+        return;
+    }
+    while (_capacity - _used < size)
+    {
+        evict(size - (_capacity - _used));
+    }
+
+    uint8_t header[HEADER_SIZE];
+    encodeHeader(header, record.ms, (uint32_t) time, (uint8_t) record.level, tagLen, taskLen, msgLen);
+    write(header, HEADER_SIZE);
+    write(record.tag, tagLen);
+    write(record.task, taskLen);
+    write(record.message, msgLen);
+}
+
+bool LogBacklog::pop(BacklogEntry& entry)
+{
+    if (_spillReadPos < _spillSize)
+    {
+        if (popFromSpill(entry))
+        {
+            return true;
+        }
+        // unreadable (e.g. damaged by a reset), give up the file
+        _droppedCount += _spillRecords;
+        resetSpill();
+    }
+    if (_used == 0)
+    {
+        return false;
+    }
+
+    uint8_t header[HEADER_SIZE];
+    read(header, HEADER_SIZE);
+    read(entry.tag, header[9]);
+    read(entry.task, header[10]);
+    read(entry.message, header[11] | (header[12] << 8));
+    finishEntry(entry, header);
+    return true;
+}
+
+unsigned long LogBacklog::takeDroppedCount()
+{
+    unsigned long count = _droppedCount;
+    _droppedCount = 0;
+    return count;
+}
+
+void LogBacklog::write(const void* data, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t first = std::min(len, _capacity - _head);
+    memcpy(&_buffer[_head], p, first);
+    memcpy(&_buffer[0], p + first, len - first);
+    _head = (_head + len) % _capacity;
+    _used += len;
+}
+
+void LogBacklog::read(void* data, size_t len)
+{
+    size_t first = std::min(len, _capacity - _tail);
+    if (data != nullptr)
+    {
+        uint8_t* p = static_cast<uint8_t*>(data);
+        memcpy(p, &_buffer[_tail], first);
+        memcpy(p + first, &_buffer[0], len - first);
+    }
+    _tail = (_tail + len) % _capacity;
+    _used -= len;
+}
+
+void LogBacklog::peekHeader(size_t offset, uint8_t* header) const
+{
+    for (size_t i = 0; i < HEADER_SIZE; i++)
+    {
+        header[i] = _buffer[(_tail + offset + i) % _capacity];
+    }
+}
+
+size_t LogBacklog::recordSize(const uint8_t* header) const
+{
+    return HEADER_SIZE + header[9] + header[10] + (header[11] | (header[12] << 8));
+}
+
+/**
+ * Count the complete records of a spill file left over from a previous
+ * run. The rest of the file (e.g. a record partially written before a
+ * reset) is counted as dropped and the file is not appended to.
+ */
+void LogBacklog::scanSpill()
+{
+    FILE* f = fopen(_spillPath.c_str(), "rb");
+    if (f == nullptr)
+    {
+        return;
+    }
+    long fileSize = -1;
+    if (fseek(f, 0, SEEK_END) == 0)
+    {
+        fileSize = ftell(f);
+    }
+    size_t pos = 0;
+    uint8_t header[HEADER_SIZE];
+    while (fileSize > 0 && fseek(f, pos, SEEK_SET) == 0 && fread(header, 1, HEADER_SIZE, f) == HEADER_SIZE)
+    {
+        size_t size = recordSize(header);
+        if (pos + size > (size_t) fileSize)
+        {
+            break;
+        }
+        pos += size;
+        _spillRecords++;
+    }
+    fclose(f);
+    _spillSize = pos;
+    _spillAppendable = fileSize >= 0 && pos == (size_t) fileSize;
+    if (fileSize > 0 && pos < (size_t) fileSize)
+    {
+        // estimate the lost records from the average size of the good ones
+        size_t average = _spillRecords > 0 ? pos / _spillRecords : HEADER_SIZE;
+        _droppedCount += std::max<size_t>(1, (fileSize - pos) / average);
+    }
+}
+
+void LogBacklog::evict(size_t needed)
+{
+    // collect the oldest records fitting into the spill file, at least needed bytes
+    size_t target = std::max(needed, _capacity / 4);
+    size_t chunk = 0;
+    unsigned long count = 0;
+    uint8_t header[HEADER_SIZE];
+    while (_spillAppendable && chunk < _used && chunk < target)
+    {
+        peekHeader(chunk, header);
+        size_t size = recordSize(header);
+        if (_spillSize + chunk + size > _spillMaxSize)
+        {
+            break;
+        }
+        chunk += size;
+        count++;
+    }
+    if (count == 0)
+    {
+        peekHeader(0, header);
+        read(nullptr, recordSize(header));
+        _droppedCount++;
+        return;
+    }
+
+    // the records are contiguous in the ring, i.e. at most two pieces
+    size_t first = std::min(chunk, _capacity - _tail);
+    bool ok = false;
+    FILE* f = fopen(_spillPath.c_str(), "ab");
+    if (f != nullptr)
+    {
+        ok = fwrite(&_buffer[_tail], 1, first, f) == first
+            && fwrite(&_buffer[0], 1, chunk - first, f) == chunk - first;
+        // buffered bytes are written (or not) when closing
+        ok = fclose(f) == 0 && ok;
+    }
+    read(nullptr, chunk);
+    if (ok)
+    {
+        _spillSize += chunk;
+        _spillRecords += count;
+    }
+    else
+    {
+        // ftruncate() is not available on all ESP-IDF file systems, so the
+        // partial bytes stay behind _spillSize until the file is removed
+        _droppedCount += count;
+        _spillAppendable = false;
+        if (_spillReadPos >= _spillSize)
+        {
+            // nothing left to replay, start over with a new file
+            resetSpill();
+        }
+    }
+}
+
+/**
+ * Make sure len bytes starting at _spillReadPos are in the spill buffer.
+ */
+bool LogBacklog::fillSpillBuffer(size_t len)
+{
+    if (_spillBufferLen - _spillBufferPos >= len)
+    {
+        return true;
+    }
+    _spillBufferPos = 0;
+    _spillBufferLen = 0;
+    FILE* f = fopen(_spillPath.c_str(), "rb");
+    if (f == nullptr)
+    {
+        return false;
+    }
+    if (fseek(f, _spillReadPos, SEEK_SET) == 0)
+    {
+        _spillBufferLen = fread(&_spillBuffer[0], 1, std::min((size_t) SPILL_READ_SIZE, _spillSize - _spillReadPos), f);
+    }
+    fclose(f);
+    return _spillBufferLen >= len;
+}
+
+bool LogBacklog::popFromSpill(BacklogEntry& entry)
+{
+    if (!fillSpillBuffer(HEADER_SIZE))
+    {
+        return false;
+    }
+    const uint8_t* header = &_spillBuffer[_spillBufferPos];
+    size_t msgLen = header[11] | (header[12] << 8);
+    size_t size = recordSize(header);
+    if (header[9] >= sizeof(entry.tag) || header[10] >= sizeof(entry.task) || msgLen >= sizeof(entry.message)
+        || !fillSpillBuffer(size))
+    {
+        return false;
+    }
+
+    // the buffer may have been refilled
+    header = &_spillBuffer[_spillBufferPos];
+    const uint8_t* p = header + HEADER_SIZE;
+    memcpy(entry.tag, p, header[9]);
+    p += header[9];
+    memcpy(entry.task, p, header[10]);
+    p += header[10];
+    memcpy(entry.message, p, msgLen);
+    finishEntry(entry, header);
+    _spillBufferPos += size;
+    _spillReadPos += size;
+    _spillRecords--;
+    if (_spillReadPos >= _spillSize)
+    {
+        resetSpill();
+    }
+    return true;
+}
+
+void LogBacklog::resetSpill()
+{
+    remove(_spillPath.c_str());
+    _spillSize = 0;
+    _spillReadPos = 0;
+    _spillRecords = 0;
+    _spillAppendable = true;
+    _spillBufferPos = 0;
+    _spillBufferLen = 0;
+}
+
+// ***************************************************************************
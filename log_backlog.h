@@ -0,0 +1,112 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+
+#include "logger.h"
+
+
+// ***************************************************************************
+
+/**
+ * A log record taken from a LogBacklog, owning copies of its strings
+ */
+struct BacklogEntry
+{
+    LogRecord record;
+    time_t time;           ///< wall clock time when the record was logged
+    char tag[32];
+    char task[24];
+    char message[LogHandler::MESSAGE_BUFLEN];
+};
+
+/**
+ * Bounded backlog of compact log records
+ *
+ * Records are stored back to back in a RAM ring buffer of the given
+ * size, with copies of tag, task name and message. If the buffer is
+ * full, the oldest records are moved to an optional spill file (e.g. on
+ * LittleFS, see FileLogHandler for paths) or dropped and counted.
+ * Records are taken out oldest first, starting with the spill file.
+ * A spill file left over from a previous run is replayed as well.
+ *
+ * The file is accessed in chunks to keep the time in push() and pop()
+ * low: a full buffer spills about a quarter of its capacity with one
+ * write, and pop() reads SPILL_READ_SIZE bytes of records at a time.
+ * After a failed write (e.g. a full file system), the partial bytes
+ * behind the last complete record are never read, and nothing more is
+ * appended until the file is replayed and removed. Records lost with
+ * the file or a failed write count as dropped.
+ *
+ * LogBacklog is not thread safe, the owner has to serialize the calls.
+ */
+class LogBacklog
+{
+public:
+    /**
+     * Construct a LogBacklog
+     * @param capacity  Size of the RAM buffer (bytes), 0 disables the backlog.
+     * @param spillPath  Path of the spill file or nullptr for RAM only.
+     * @param spillMaxSize  Maximum size of the spill file (bytes).
+     */
+    LogBacklog(size_t capacity, const char* spillPath = nullptr, size_t spillMaxSize = 0);
+
+    /**
+     * Add a record, making room by spilling or dropping the oldest ones.
+     */
+    void push(const LogRecord& record, time_t time);
+
+    /**
+     * Remove the oldest record and copy it to entry.
+     * @return `false` if the backlog is empty.
+     */
+    bool pop(BacklogEntry& entry);
+
+    bool empty() const { return _used == 0 && _spillReadPos >= _spillSize; }
+
+    /**
+     * Return the number of dropped records since the last call.
+     */
+    unsigned long takeDroppedCount();
+
+private:
+    static constexpr size_t HEADER_SIZE = 13;
+    static constexpr size_t SPILL_READ_SIZE = 1024;
+
+    void write(const void* data, size_t len);
+    void read(void* data, size_t len);
+    void peekHeader(size_t offset, uint8_t* header) const;
+    size_t recordSize(const uint8_t* header) const;
+    void scanSpill();
+    void evict(size_t needed);
+    bool fillSpillBuffer(size_t len);
+    bool popFromSpill(BacklogEntry& entry);
+    void resetSpill();
+
+    std::unique_ptr<uint8_t[]> _buffer;
+    size_t _capacity;
+    size_t _head;
+    size_t _tail;
+    size_t _used;
+
+    std::string _spillPath;
+    size_t _spillMaxSize;
+    size_t _spillSize;
+    size_t _spillReadPos;
+    unsigned long _spillRecords;  ///< complete records behind _spillReadPos
+    bool _spillAppendable;        ///< `false` after a failed write
+    std::unique_ptr<uint8_t[]> _spillBuffer;
+    size_t _spillBufferPos;    ///< position of _spillReadPos in _spillBuffer
+    size_t _spillBufferLen;
+
+    unsigned long _droppedCount;
+};
+
+// ***************************************************************************
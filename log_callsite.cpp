@@ -0,0 +1,281 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "log_callsite.h"
+
+
+// ***************************************************************************
+
+namespace {
+
+/**
+ * Selection of call sites with the state to set
+ */
+struct Rule
+{
+    std::string file;  // empty for any
+    int firstLine;
+    int lastLine;
+    std::string formatPart;  // empty for any
+    bool enabled;
+
+    bool sameSelection(const Rule& other) const
+    {
+        return file == other.file && firstLine == other.firstLine
+            && lastLine == other.lastLine && formatPart == other.formatPart;
+    }
+
+    bool matches(const LogCallSite& site) const
+    {
+        if (site.line < firstLine || site.line > lastLine)
+        {
+            return false;
+        }
+        if (!file.empty())
+        {
+            size_t len = strlen(site.file);
+            if (len < file.size() || strcmp(site.file + len - file.size(), file.c_str()) != 0)
+            {
+                return false;
+            }
+            if (len > file.size() && site.file[len - file.size() - 1] != '/')
+            {
+                return false;
+            }
+        }
+        return formatPart.empty() || strstr(site.format, formatPart.c_str()) != nullptr;
+    }
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    LogCallSite* head = nullptr;
+    std::vector<Rule> rules;
+};
+
+/**
+ * The registry is created on first use, call sites may run during static initialization.
+ */
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+/**
+ * Next word of command, a quoted string may contain spaces.
+ */
+bool nextWord(const char*& p, std::string& word)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+    {
+        p++;
+    }
+    if (*p == '\0')
+    {
+        return false;
+    }
+    const char* start = p;
+    if (*p == '"')
+    {
+        start = ++p;
+        while (*p != '\0' && *p != '"')
+        {
+            p++;
+        }
+        word.assign(start, p - start);
+        if (*p == '"')
+        {
+            p++;
+        }
+        return true;
+    }
+    while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+    {
+        p++;
+    }
+    word.assign(start, p - start);
+    return true;
+}
+
+/**
+ * Parse a line number or range like `10`, `10-20`, `10-` or `-20`.
+ */
+bool parseLines(const std::string& word, int& firstLine, int& lastLine)
+{
+    const char* p = word.c_str();
+    char* end;
+    size_t dash = word.find('-');
+    if (dash == std::string::npos)
+    {
+        firstLine = lastLine = (int) strtol(p, &end, 10);
+        return end != p && *end == '\0';
+    }
+    firstLine = 0;
+    lastLine = INT_MAX;
+    if (dash > 0)
+    {
+        firstLine = (int) strtol(p, &end, 10);
+        if (end != p + dash)
+        {
+            return false;
+        }
+    }
+    if (dash + 1 < word.size())
+    {
+        lastLine = (int) strtol(p + dash + 1, &end, 10);
+        if (*end != '\0')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+// ***************************************************************************
+
+int LogCallSites::setEnabled(bool enabled, const char* file, int firstLine, int lastLine, const char* formatPart)
+{
+    Rule rule;
+    rule.file = file == nullptr ? "" : file;
+    rule.firstLine = firstLine;
+    rule.lastLine = lastLine;
+    rule.formatPart = formatPart == nullptr ? "" : formatPart;
+    rule.enabled = enabled;
+
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    int count = 0;
+    for (LogCallSite* site = r.head; site != nullptr; site = site->next)
+    {
+        if (rule.matches(*site))
+        {
+            site->state.store(enabled ? LogCallSite::ENABLED : LogCallSite::DISABLED, std::memory_order_relaxed);
+            count++;
+        }
+    }
+
+    // remember the rule for call sites registered later
+    for (auto it = r.rules.begin(); it != r.rules.end(); ++it)
+    {
+        if (it->sameSelection(rule))
+        {
+            r.rules.erase(it);
+            break;
+        }
+    }
+    if (r.rules.size() >= MAX_RULES)
+    {
+        r.rules.erase(r.rules.begin());
+    }
+    r.rules.push_back(rule);
+    return count;
+}
+
+int LogCallSites::control(const char* command)
+{
+    const char* file = nullptr;
+    int firstLine = 0;
+    int lastLine = INT_MAX;
+    std::string fileWord;
+    std::string formatWord;
+    bool hasFormat = false;
+
+    const char* p = command;
+    std::string word;
+    while (nextWord(p, word))
+    {
+        if (word == "+p" || word == "-p")
+        {
+            std::string rest;
+            if (nextWord(p, rest))
+            {
+                return -1;
+            }
+            return setEnabled(word[0] == '+', file, firstLine, lastLine, hasFormat ? formatWord.c_str() : nullptr);
+        }
+        std::string value;
+        if (!nextWord(p, value))
+        {
+            return -1;
+        }
+        if (word == "file")
+        {
+            fileWord = value;
+            file = fileWord.c_str();
+        }
+        else if (word == "line")
+        {
+            if (!parseLines(value, firstLine, lastLine))
+            {
+                return -1;
+            }
+        }
+        else if (word == "format")
+        {
+            formatWord = value;
+            hasFormat = true;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+void LogCallSites::forEach(std::function<void(const LogCallSite&)> fn)
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const LogCallSite* site = r.head; site != nullptr; site = site->next)
+    {
+        fn(*site);
+    }
+}
+
+void LogCallSites::log(LogCallSite& site, const Logger& logger, const char* format...)
+{
+    if (site.state.load(std::memory_order_acquire) == LogCallSite::UNREGISTERED)
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        // another task may have registered the site in the meantime
+        if (site.state.load(std::memory_order_relaxed) == LogCallSite::UNREGISTERED)
+        {
+            bool enabled = false;
+            for (const Rule& rule : r.rules)
+            {
+                if (rule.matches(site))
+                {
+                    enabled = rule.enabled;
+                }
+            }
+            site.next = r.head;
+            r.head = &site;
+            site.state.store(enabled ? LogCallSite::ENABLED : LogCallSite::DISABLED, std::memory_order_release);
+        }
+    }
+    if (site.state.load(std::memory_order_relaxed) != LogCallSite::ENABLED)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    logger.writev(Logger::LogLevel::DEBUG, format, args);
+    va_end(args);
+}
+
+// ***************************************************************************
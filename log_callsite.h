@@ -0,0 +1,116 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <functional>
+
+#include "logger.h"
+
+
+// ***************************************************************************
+
+/**
+ * Static descriptor of a log statement with its own enable switch
+ *
+ * A descriptor is created for each LOG_DYNAMIC_DEBUG() statement. It is
+ * registered with LogCallSites when the statement is executed for the
+ * first time. Afterwards, a disabled statement costs one load and one
+ * branch.
+ */
+struct LogCallSite
+{
+    enum State : uint8_t { UNREGISTERED = 0, DISABLED = 1, ENABLED = 2 };
+
+    const char* file;
+    int line;
+    const char* format;
+    std::atomic<uint8_t> state;
+    LogCallSite* next;  ///< next registered call site
+};
+
+/**
+ * Debug output which can be enabled per call site at runtime
+ *
+ * Similar to Linux' dynamic debug, the message is written with level
+ * DEBUG if this very statement has been enabled via LogCallSites,
+ * regardless of the Logger's log level. All statements are disabled
+ * by default.
+ */
+#define LOG_DYNAMIC_DEBUG(logger, format, ...) \
+    do \
+    { \
+        static LogCallSite _logCallSite = { __FILE__, __LINE__, format, { LogCallSite::UNREGISTERED }, nullptr }; \
+        if (_logCallSite.state.load(std::memory_order_relaxed) != LogCallSite::DISABLED) \
+        { \
+            LogCallSites::log(_logCallSite, logger, format, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+/**
+ * Registry of all LOG_DYNAMIC_DEBUG() call sites executed so far
+ *
+ * Call sites are selected by file, line range and a substring of the
+ * format. A file matches if it is the call site's path or a trailing
+ * part of it after a '/', e.g. `main.cpp` or `src/main.cpp`. Selections
+ * are remembered (up to MAX_RULES) and applied to call sites registered
+ * later, so statements can be enabled before they run for the first
+ * time.
+ */
+class LogCallSites
+{
+public:
+    /**
+     * Enable the selected call sites.
+     * @param file  File name or trailing part of the path, nullptr for any.
+     * @param firstLine  First line of the range.
+     * @param lastLine  Last line of the range.
+     * @param formatPart  Substring of the format, nullptr for any.
+     * @return Number of registered call sites selected.
+     */
+    static int enable(const char* file, int firstLine = 0, int lastLine = INT_MAX, const char* formatPart = nullptr)
+    {
+        return setEnabled(true, file, firstLine, lastLine, formatPart);
+    }
+
+    /**
+     * Disable the selected call sites, see enable().
+     */
+    static int disable(const char* file, int firstLine = 0, int lastLine = INT_MAX, const char* formatPart = nullptr)
+    {
+        return setEnabled(false, file, firstLine, lastLine, formatPart);
+    }
+
+    static int setEnabled(bool enabled, const char* file, int firstLine, int lastLine, const char* formatPart);
+
+    /**
+     * Enable or disable call sites given by a command like
+     * `file main.cpp line 10-20 format "pressure" +p`, e.g. read from a
+     * serial console. Each of `file`, `line` (a number or range) and
+     * `format` is optional; the command ends with `+p` to enable or
+     * `-p` to disable.
+     * @return Number of registered call sites selected or -1 if the
+     *         command is invalid.
+     */
+    static int control(const char* command);
+
+    /**
+     * Call fn for each registered call site.
+     */
+    static void forEach(std::function<void(const LogCallSite&)> fn);
+
+    /**
+     * Register a call site if necessary and write the message if enabled.
+     * Used by LOG_DYNAMIC_DEBUG().
+     */
+    static void log(LogCallSite& site, const Logger& logger, const char* format...);
+
+    static constexpr size_t MAX_RULES = 16;
+};
+
+// ***************************************************************************
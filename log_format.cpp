@@ -0,0 +1,718 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "log_format.h"
+
+
+// ***************************************************************************
+
+namespace {
+
+const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+const uint32_t POWERS_OF_10[] =
+{
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+const int MAX_FAST_PRECISION = 9;
+const double MAX_FAST_FLOAT = 1e15;
+const int MAX_WIDTH = 999;
+
+/**
+ * One conversion specification like `%-08lx`
+ */
+struct Spec
+{
+    bool left;
+    bool zero;
+    int width;
+    int precision;  // -1 if not given
+    char length;    // 0, 'l', 'L' (ll) or 'z'
+    char conversion;
+};
+
+/**
+ * Parse the specification following a '%'.
+ * @return Pointer behind the specification or nullptr if not supported.
+ */
+const char* parseSpec(const char* p, Spec& spec)
+{
+    spec.left = false;
+    spec.zero = false;
+    spec.width = 0;
+    spec.precision = -1;
+    spec.length = 0;
+
+    for (;; p++)
+    {
+        if (*p == '-')
+        {
+            spec.left = true;
+        }
+        else if (*p == '0')
+        {
+            spec.zero = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+    while (*p >= '0' && *p <= '9')
+    {
+        spec.width = spec.width*10 + (*p++ - '0');
+        if (spec.width > MAX_WIDTH)
+        {
+            return nullptr;
+        }
+    }
+    if (*p == '.')
+    {
+        p++;
+        spec.precision = 0;
+        while (*p >= '0' && *p <= '9')
+        {
+            spec.precision = spec.precision*10 + (*p++ - '0');
+            if (spec.precision > MAX_WIDTH)
+            {
+                return nullptr;
+            }
+        }
+    }
+    if (*p == 'l')
+    {
+        p++;
+        spec.length = 'l';
+        if (*p == 'l')
+        {
+            p++;
+            spec.length = 'L';
+        }
+    }
+    else if (*p == 'z')
+    {
+        p++;
+        spec.length = 'z';
+    }
+
+    spec.conversion = *p;
+    switch (spec.conversion)
+    {
+    case 'd': case 'i': case 'u': case 'x': case 'X':
+        // precision means minimum digits here, leave that to vsnprintf
+        return spec.precision < 0 ? p + 1 : nullptr;
+    case 'f':
+        return spec.length == 0 || spec.length == 'l' ? p + 1 : nullptr;
+    case 's':
+        return spec.length == 0 && !spec.zero ? p + 1 : nullptr;
+    case 'c':
+        return spec.length == 0 && !spec.zero && spec.precision < 0 ? p + 1 : nullptr;
+    default:
+        return nullptr;
+    }
+}
+
+/**
+ * `true` if all conversions in format are supported
+ */
+bool isSupported(const char* format)
+{
+    Spec spec;
+    const char* p = format;
+    while ((p = strchr(p, '%')) != nullptr)
+    {
+        if (p[1] == '%')
+        {
+            p += 2;
+            continue;
+        }
+        p = parseSpec(p + 1, spec);
+        if (p == nullptr)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Bounded output with vsnprintf() semantics: count everything, store what fits
+ */
+struct Output
+{
+    char* buf;
+    size_t size;
+    size_t len;
+
+    size_t room() const
+    {
+        return len + 1 < size ? size - 1 - len : 0;
+    }
+
+    void put(char c)
+    {
+        if (len + 1 < size)
+        {
+            buf[len] = c;
+        }
+        len++;
+    }
+
+    void put(const char* str, size_t n)
+    {
+        size_t stored = n < room() ? n : room();
+        if (stored > 0)
+        {
+            memcpy(buf + len, str, stored);
+        }
+        len += n;
+    }
+
+    void pad(char c, int n)
+    {
+        for (; n > 0; n--)
+        {
+            put(c);
+        }
+    }
+
+    /**
+     * Put the output of snprintf() for a single conversion.
+     */
+    template <typename T>
+    void putFormatted(const char* format, T value)
+    {
+        size_t available = room();
+        int n = snprintf(available > 0 ? buf + len : nullptr, available > 0 ? available + 1 : 0, format, value);
+        if (n > 0)
+        {
+            len += n;
+        }
+    }
+
+    /**
+     * Put an optional sign and the digits into a field of the given spec.
+     */
+    void putField(const Spec& spec, char sign, const char* digits, size_t n)
+    {
+        int fill = spec.width - (int) n - (sign != 0 ? 1 : 0);
+        if (!spec.left && !spec.zero)
+        {
+            pad(' ', fill);
+        }
+        if (sign != 0)
+        {
+            put(sign);
+        }
+        if (!spec.left && spec.zero)
+        {
+            pad('0', fill);
+        }
+        put(digits, n);
+        if (spec.left)
+        {
+            pad(' ', fill);
+        }
+    }
+};
+
+/**
+ * Convert value into the digits ending at end.
+ *
+ * 64 bit division is a library call on 32 bit targets (`__udivdi3` on
+ * the ESP32), so it is only used until the rest fits into 32 bits.
+ * @return Pointer to the first digit
+ */
+char* formatDecimal(char* end, unsigned long long value)
+{
+    char* p = end;
+    while (value > UINT32_MAX)
+    {
+        unsigned index = (unsigned) (value % 100) * 2;
+        value /= 100;
+        *--p = DIGIT_PAIRS[index + 1];
+        *--p = DIGIT_PAIRS[index];
+    }
+    uint32_t value32 = (uint32_t) value;
+    while (value32 >= 100)
+    {
+        unsigned index = (value32 % 100) * 2;
+        value32 /= 100;
+        *--p = DIGIT_PAIRS[index + 1];
+        *--p = DIGIT_PAIRS[index];
+    }
+    if (value32 >= 10)
+    {
+        unsigned index = value32 * 2;
+        *--p = DIGIT_PAIRS[index + 1];
+        *--p = DIGIT_PAIRS[index];
+    }
+    else
+    {
+        *--p = '0' + (char) value32;
+    }
+    return p;
+}
+
+char* formatHex(char* end, unsigned long long value, bool upper)
+{
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char* p = end;
+    do
+    {
+        *--p = digits[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+    return p;
+}
+
+/**
+ * Rounding error of product = a*b, i.e. the exact a*b - product (Dekker)
+ */
+double productError(double a, double b, double product)
+{
+    const double SPLIT = 134217729.0;  // 2^27 + 1
+    double t = SPLIT * a;
+    double aHigh = t - (t - a);
+    double aLow = a - aHigh;
+    t = SPLIT * b;
+    double bHigh = t - (t - b);
+    double bLow = b - bHigh;
+    return ((aHigh*bHigh - product) + aHigh*bLow + aLow*bHigh) + aLow*bLow;
+}
+
+void formatString(Output& out, const Spec& spec, const char* str)
+{
+    if (str == nullptr)
+    {
+        // like glibc
+        str = spec.precision < 0 || spec.precision >= 6 ? "(null)" : "";
+    }
+    size_t n = spec.precision < 0 ? strlen(str) : strnlen(str, spec.precision);
+    int fill = spec.width - (int) n;
+    if (!spec.left)
+    {
+        out.pad(' ', fill);
+    }
+    out.put(str, n);
+    if (spec.left)
+    {
+        out.pad(' ', fill);
+    }
+}
+
+void formatFloat(Output& out, const Spec& spec, double value)
+{
+    int precision = spec.precision < 0 ? 6 : spec.precision;
+    double magnitude = fabs(value);
+    if (std::isfinite(value) && precision <= MAX_FAST_PRECISION && magnitude < MAX_FAST_FLOAT)
+    {
+        // the integer part and the remainder are exact, only the scaling
+        // of the remainder is rounded (by less than a unit in the last place)
+        unsigned long long integer = (unsigned long long) magnitude;
+        double remainder = magnitude - (double) integer;
+        double scaled = remainder * POWERS_OF_10[precision];
+        double fraction = floor(scaled);
+        double rest = scaled - fraction;
+        bool roundUp = rest > 0.5;
+        if (fabs(rest - 0.5) <= 1e-9 + scaled * 4 * DBL_EPSILON)
+        {
+            // close to a tie, decide with the exact error of the scaling
+            // and round a real tie to even like the C library
+            double diff = (rest - 0.5) + productError(remainder, POWERS_OF_10[precision], scaled);
+            bool odd = precision > 0 ? fmod(fraction, 2) != 0 : (integer & 1) != 0;
+            roundUp = diff > 0 || (diff == 0 && odd);
+        }
+        uint32_t digits = (uint32_t) fraction + (roundUp ? 1 : 0);
+        if (digits >= POWERS_OF_10[precision])
+        {
+            digits -= POWERS_OF_10[precision];
+            integer++;
+        }
+
+        char buf[32];
+        char* end = buf + sizeof(buf);
+        char* p = end;
+        if (precision > 0)
+        {
+            char* fractionStart = end - precision;
+            p = formatDecimal(end, digits);
+            while (p > fractionStart)
+            {
+                *--p = '0';
+            }
+            *--p = '.';
+        }
+        p = formatDecimal(p, integer);
+        out.putField(spec, std::signbit(value) ? '-' : 0, p, end - p);
+        return;
+    }
+
+    // large values, high precision, inf and nan
+    char format[32] = "%";
+    size_t n = 1;
+    if (spec.left)
+    {
+        format[n++] = '-';
+    }
+    if (spec.zero)
+    {
+        format[n++] = '0';
+    }
+    logSnprintf(format + n, sizeof(format) - n, "%d.%df", spec.width, precision);
+    out.putFormatted(format, value);
+}
+
+/**
+ * Format a conversion outside the fast subset with snprintf(), taking
+ * an argument of the type given by the conversion from args.
+ * @param p  Specification following the '%'.
+ * @return Pointer behind the specification
+ */
+template <typename Args>
+const char* formatOther(Output& out, const char* p, Args& args)
+{
+    const char* start = p - 1;
+    char format[48] = "%";
+    size_t n = 1;
+    while (*p != '\0' && strchr("-+ #0", *p) != nullptr)
+    {
+        if (n < 8)
+        {
+            format[n++] = *p;
+        }
+        p++;
+    }
+
+    int width = -1;
+    int precision = -1;
+    if (*p == '*')
+    {
+        p++;
+        width = args.nextInt();
+        if (width < 0)
+        {
+            format[n++] = '-';
+            width = -width;
+        }
+    }
+    else if (*p >= '0' && *p <= '9')
+    {
+        width = (int) strtol(p, (char**) &p, 10);
+    }
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            p++;
+            precision = args.nextInt();
+        }
+        else
+        {
+            precision = (int) strtol(p, (char**) &p, 10);
+        }
+    }
+    if (width > MAX_WIDTH || precision > MAX_WIDTH)
+    {
+        // not worth the stack
+        width = -1;
+        precision = -1;
+    }
+    if (width >= 0)
+    {
+        n += logSnprintf(format + n, sizeof(format) - n, "%d", width);
+    }
+    if (precision >= 0)
+    {
+        n += logSnprintf(format + n, sizeof(format) - n, ".%d", precision);
+    }
+
+    // h, hh, l, ll, L, j, z, t, q
+    char length = 0;
+    while (*p != '\0' && strchr("hlLjztq", *p) != nullptr)
+    {
+        length = (length == *p && (*p == 'h' || *p == 'l')) ? (char) toupper(*p) : *p;
+        p++;
+    }
+    if (length == 'q')
+    {
+        length = 'L';
+    }
+
+    char conversion = *p;
+    switch (conversion)
+    {
+    case 'd': case 'i':
+        strcpy(format + n, conversion == 'd' ? "lld" : "lli");
+        out.putFormatted(format, args.nextSigned(length));
+        break;
+    case 'o': case 'u': case 'x': case 'X':
+        format[n++] = 'l';
+        format[n++] = 'l';
+        format[n++] = conversion;
+        format[n] = '\0';
+        out.putFormatted(format, args.nextUnsigned(length));
+        break;
+    case 'c':
+        strcpy(format + n, "c");
+        out.putFormatted(format, args.nextInt());
+        break;
+    case 's':
+        strcpy(format + n, "s");
+        out.putFormatted(format, (const char*) args.nextPointer());
+        break;
+    case 'p':
+        strcpy(format + n, "p");
+        out.putFormatted(format, args.nextPointer());
+        break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        format[n++] = conversion;
+        format[n] = '\0';
+        out.putFormatted(format, args.nextDouble());
+        break;
+    case 'n':
+        // no writes through log arguments
+        args.nextPointer();
+        break;
+    default:
+        // unknown conversion, copy it
+        out.put(start, p - start + (conversion != '\0' ? 1 : 0));
+        return conversion != '\0' ? p + 1 : p;
+    }
+    return p + 1;
+}
+
+/**
+ * Format into out, taking the arguments from args.
+ */
+template <typename Args>
+void formatArgs(Output& out, const char* format, Args& args)
+{
+    const char* p = format;
+    while (*p != '\0')
+    {
+        const char* percent = strchr(p, '%');
+        if (percent == nullptr)
+        {
+            out.put(p, strlen(p));
+            break;
+        }
+        out.put(p, percent - p);
+        if (percent[1] == '%')
+        {
+            out.put('%');
+            p = percent + 2;
+            continue;
+        }
+
+        Spec spec;
+        p = parseSpec(percent + 1, spec);
+        if (p == nullptr)
+        {
+            p = formatOther(out, percent + 1, args);
+            continue;
+        }
+        char digits[24];
+        char* end = digits + sizeof(digits);
+        switch (spec.conversion)
+        {
+        case 'd':
+        case 'i':
+        {
+            long long value = args.nextSigned(spec.length);
+            unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long) value : value;
+            char* start = formatDecimal(end, magnitude);
+            out.putField(spec, value < 0 ? '-' : 0, start, end - start);
+            break;
+        }
+        case 'u':
+        case 'x':
+        case 'X':
+        {
+            unsigned long long value = args.nextUnsigned(spec.length);
+            char* start = spec.conversion == 'u'
+                ? formatDecimal(end, value)
+                : formatHex(end, value, spec.conversion == 'X');
+            out.putField(spec, 0, start, end - start);
+            break;
+        }
+        case 'c':
+            digits[0] = (char) args.nextInt();
+            out.putField(spec, 0, digits, 1);
+            break;
+        case 's':
+            formatString(out, spec, (const char*) args.nextPointer());
+            break;
+        case 'f':
+            formatFloat(out, spec, args.nextDouble());
+            break;
+        }
+    }
+}
+
+int finish(Output& out)
+{
+    if (out.size > 0)
+    {
+        out.buf[out.len < out.size ? out.len : out.size - 1] = '\0';
+    }
+    return (int) out.len;
+}
+
+/**
+ * Arguments from a va_list, with the types given by the format
+ */
+struct VaListArgs
+{
+    va_list ap;
+
+    int nextInt() { return va_arg(ap, int); }
+    double nextDouble() { return va_arg(ap, double); }
+    const void* nextPointer() { return va_arg(ap, const void*); }
+
+    long long nextSigned(char length)
+    {
+        switch (length)
+        {
+        case 'H': return (signed char) va_arg(ap, int);
+        case 'h': return (short) va_arg(ap, int);
+        case 'l': return va_arg(ap, long);
+        case 'L': return va_arg(ap, long long);
+        case 'j': return va_arg(ap, intmax_t);
+        case 'z': case 't': return va_arg(ap, ptrdiff_t);
+        default: return va_arg(ap, int);
+        }
+    }
+
+    unsigned long long nextUnsigned(char length)
+    {
+        switch (length)
+        {
+        case 'H': return (unsigned char) va_arg(ap, unsigned);
+        case 'h': return (unsigned short) va_arg(ap, unsigned);
+        case 'l': return va_arg(ap, unsigned long);
+        case 'L': return va_arg(ap, unsigned long long);
+        case 'j': return va_arg(ap, uintmax_t);
+        case 'z': case 't': return va_arg(ap, size_t);
+        default: return va_arg(ap, unsigned);
+        }
+    }
+};
+
+/**
+ * Arguments captured as LogArg, missing arguments are 0
+ */
+struct ArrayArgs
+{
+    const LogArg* args;
+    int count;
+
+    uint64_t next()
+    {
+        if (count <= 0)
+        {
+            return 0;
+        }
+        count--;
+        return (args++)->bits;
+    }
+
+    int nextInt() { return (int) next(); }
+    const void* nextPointer() { return (const void*) (uintptr_t) next(); }
+
+    double nextDouble()
+    {
+        uint64_t bits = next();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    long long nextSigned(char length)
+    {
+        uint64_t bits = next();
+        switch (length)
+        {
+        case 'H': return (signed char) bits;
+        case 'h': return (short) bits;
+        case 'l': return (long) bits;
+        case 'L': case 'j': return (long long) bits;
+        case 'z': case 't': return (ptrdiff_t) bits;
+        default: return (int) bits;
+        }
+    }
+
+    unsigned long long nextUnsigned(char length)
+    {
+        uint64_t bits = next();
+        switch (length)
+        {
+        case 'H': return (unsigned char) bits;
+        case 'h': return (unsigned short) bits;
+        case 'l': return (unsigned long) bits;
+        case 'L': case 'j': return bits;
+        case 'z': case 't': return (size_t) bits;
+        default: return (unsigned) bits;
+        }
+    }
+};
+
+}
+
+// ***************************************************************************
+
+int logVsnprintf(char* buf, size_t size, const char* format, va_list ap)
+{
+    if (!isSupported(format))
+    {
+        return vsnprintf(buf, size, format, ap);
+    }
+
+    Output out = { buf, size, 0 };
+    VaListArgs args;
+    va_copy(args.ap, ap);
+    formatArgs(out, format, args);
+    va_end(args.ap);
+    return finish(out);
+}
+
+int logFormatArgs(char* buf, size_t size, const char* format, const LogArg* args, int count)
+{
+    Output out = { buf, size, 0 };
+    ArrayArgs source = { args, count };
+    formatArgs(out, format, source);
+    return finish(out);
+}
+
+int logSnprintf(char* buf, size_t size, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = logVsnprintf(buf, size, format, args);
+    va_end(args);
+    return len;
+}
+
+// ***************************************************************************
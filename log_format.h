@@ -0,0 +1,88 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Capture code is inlined into the interrupt handler, so it ends up in
+ * IRAM together with an IRAM_ATTR handler on the ESP32. This also holds
+ * at -O0 and -Og, where plain inline functions are called out of line.
+ */
+#define LOGGER32_ISR_INLINE inline __attribute__((always_inline))
+
+
+// ***************************************************************************
+
+/**
+ * Drop-in replacement for vsnprintf() for the formats used in log messages
+ *
+ * Conversions `%d %i %u %x %X %s %c %f %%` with the length modifiers
+ * `l`, `ll` and `z`, the flags `-` and `0`, a field width and a
+ * precision for `%s` and `%f` are formatted directly into buf. The
+ * result is the same as with the C library, but without locale lookups,
+ * locks and the large stack frame of newlib's vsnprintf().
+ *
+ * The format is checked before any argument is taken. Format strings
+ * with other conversions, flags or modifiers (e.g. `%p`, `%+d`, `%*d`,
+ * `%hd`, `%g`) are passed on to vsnprintf() as a whole. `%f` values
+ * of 1e15 and above, inf, nan and precisions above 9 are formatted
+ * with snprintf().
+ *
+ * @return Length of the full output as with vsnprintf(); the output is
+ *         truncated to size-1 characters and 0-terminated if size > 0.
+ */
+int logVsnprintf(char* buf, size_t size, const char* format, va_list ap);
+
+/**
+ * Drop-in replacement for snprintf(), see logVsnprintf().
+ */
+int logSnprintf(char* buf, size_t size, const char* format, ...);
+
+/**
+ * A scalar printf() argument captured for formatting later
+ *
+ * Integers and enums are stored sign or zero extended, doubles and
+ * floats as the bits of a double and pointers (including strings) as
+ * their address.
+ * The conversion in the format selects the interpretation.
+ */
+struct LogArg
+{
+    uint64_t bits;
+
+    // the constructors run in interrupt handlers, see IsrLogBuffer
+    LOGGER32_ISR_INLINE LogArg(): bits(0) {}
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    LOGGER32_ISR_INLINE LogArg(T value):
+        bits((uint64_t) (typename std::conditional<std::is_signed<T>::value, int64_t, uint64_t>::type) value)
+    {}
+
+    // an unscoped enum would otherwise convert to double
+    template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    LOGGER32_ISR_INLINE LogArg(T value):
+        LogArg(static_cast<typename std::underlying_type<T>::type>(value))
+    {}
+
+    LogArg(double value) { memcpy(&bits, &value, sizeof(bits)); }
+    LOGGER32_ISR_INLINE LogArg(const void* value): bits((uintptr_t) value) {}
+};
+
+/**
+ * Format with arguments captured as LogArg, see logVsnprintf().
+ *
+ * Conversions outside the fast subset (e.g. `%p`, `%+d`, `%g`) are
+ * formatted one by one with snprintf(). Missing arguments are taken
+ * as 0.
+ */
+int logFormatArgs(char* buf, size_t size, const char* format, const LogArg* args, int count);
+
+// ***************************************************************************
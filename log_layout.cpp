@@ -0,0 +1,221 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <cstring>
+
+#include "logger.h"
+#include "log_layout.h"
+
+
+// ***************************************************************************
+
+namespace {
+
+const char* LEVEL_NAMES[] =
+{
+    /*0*/"NOTSET", /*1*/"DEBUG", /*2*/"INFO", /*3*/"WARNING", /*4*/"ERROR", /*5*/"CRITICAL",
+};
+
+/**
+ * Bounded output position in the render buffer
+ */
+struct Output
+{
+    char* p;
+    char* end;  // last usable position, reserved for the terminating 0
+
+    void append(const char* str, size_t len)
+    {
+        size_t room = end - p;
+        if (len > room)
+        {
+            len = room;
+        }
+        memcpy(p, str, len);
+        p += len;
+    }
+
+    void appendField(const char* str, bool nil)
+    {
+        if (str == nullptr || *str == '\0')
+        {
+            if (nil)
+            {
+                append("-", 1);
+            }
+            return;
+        }
+        while (*str != '\0' && p < end)
+        {
+            *p++ = *str++;
+        }
+    }
+
+    void appendUInt(unsigned long value, int minDigits = 1)
+    {
+        char digits[24];
+        int n = 0;
+        do
+        {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value != 0);
+        while (n < minDigits)
+        {
+            digits[n++] = '0';
+        }
+        while (n > 0 && p < end)
+        {
+            *p++ = digits[--n];
+        }
+    }
+};
+
+/**
+ * Format time as RFC 3339 UTC timestamp, caching the last second per thread.
+ */
+const char* formatTime(time_t time)
+{
+    static thread_local time_t cachedTime = (time_t) -1;
+    static thread_local char cachedStr[32];
+    if (time != cachedTime)
+    {
+        struct tm timeinfo;
+        gmtime_r(&time, &timeinfo);
+        strftime(cachedStr, sizeof(cachedStr), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+        cachedTime = time;
+    }
+    return cachedStr;
+}
+
+}
+
+// ***************************************************************************
+
+LogLayout::LogLayout(const char* pattern):
+    _needsTime(false)
+{
+    const char* p = pattern;
+    while (*p != '\0')
+    {
+        if (p[0] == '%' && p[1] != '\0')
+        {
+            bool nil = p[1] == '-' && p[2] != '\0';
+            char c = nil ? p[2] : p[1];
+            Op op = { OpCode::LITERAL, nil, 0, 0 };
+            bool known = true;
+            switch (c)
+            {
+            case 'U': op.code = OpCode::UPTIME; break;
+            case 'u': op.code = OpCode::UPTIME_MS; break;
+            case 'T': op.code = OpCode::TIME; _needsTime = true; break;
+            case 'L': op.code = OpCode::LEVEL; break;
+            case 'N': op.code = OpCode::LEVEL_NAME; break;
+            case 'P': op.code = OpCode::PRI; break;
+            case 'd': op.code = OpCode::DEVICE; break;
+            case 't': op.code = OpCode::TAG; break;
+            case 'k': op.code = OpCode::TASK; break;
+            case 'm': op.code = OpCode::MESSAGE; break;
+            case 'C': op.code = OpCode::COLOR_START; break;
+            case 'c': op.code = OpCode::COLOR_END; break;
+            default: known = false; break;
+            }
+            if (known)
+            {
+                _ops.push_back(op);
+                p += nil ? 3 : 2;
+                continue;
+            }
+            if (c == '%' && !nil)
+            {
+                p++;  // copy one '%' below
+            }
+        }
+
+        // literal text up to the next '%' (merged with a preceding literal)
+        const char* start = p;
+        p++;
+        while (*p != '\0' && *p != '%')
+        {
+            p++;
+        }
+        if (!_ops.empty() && _ops.back().code == OpCode::LITERAL
+            && _ops.back().offset + _ops.back().length == _literals.size())
+        {
+            _ops.back().length += p - start;
+        }
+        else
+        {
+            Op op = { OpCode::LITERAL, false, (uint16_t) _literals.size(), (uint16_t) (p - start) };
+            _ops.push_back(op);
+        }
+        _literals.append(start, p - start);
+    }
+}
+
+int LogLayout::render(char* buf, int size, const LogRecord& record, const Context& context) const
+{
+    if (size <= 0)
+    {
+        return 0;
+    }
+    Output out = { buf, buf + size - 1 };
+    int level = static_cast<int>(record.level);
+    for (const Op& op : _ops)
+    {
+        switch (op.code)
+        {
+        case OpCode::LITERAL:
+            out.append(&_literals[op.offset], op.length);
+            break;
+        case OpCode::UPTIME:
+            out.appendUInt(record.ms / 1000);
+            out.append(".", 1);
+            out.appendUInt(record.ms % 1000, 3);
+            break;
+        case OpCode::UPTIME_MS:
+            out.appendUInt(record.ms);
+            break;
+        case OpCode::TIME:
+            out.appendField(formatTime(context.time), op.nil);
+            break;
+        case OpCode::LEVEL:
+            out.appendUInt(level < 0 ? 0 : level, 2);
+            break;
+        case OpCode::LEVEL_NAME:
+        {
+            int index = level < 0 ? 0 : level / 10;
+            const int count = sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0]);
+            out.appendField(LEVEL_NAMES[index < count ? index : count - 1], op.nil);
+            break;
+        }
+        case OpCode::PRI:
+            out.appendUInt(context.pri < 0 ? 0 : context.pri);
+            break;
+        case OpCode::DEVICE:
+            out.appendField(context.deviceId, op.nil);
+            break;
+        case OpCode::TAG:
+            out.appendField(record.tag, op.nil);
+            break;
+        case OpCode::TASK:
+            out.appendField(record.task, op.nil);
+            break;
+        case OpCode::MESSAGE:
+            out.appendField(record.message, op.nil);
+            break;
+        case OpCode::COLOR_START:
+            out.appendField(context.colorStart, false);
+            break;
+        case OpCode::COLOR_END:
+            out.appendField(context.colorEnd, false);
+            break;
+        }
+    }
+    *out.p = '\0';
+    return out.p - buf;
+}
+
+// ***************************************************************************
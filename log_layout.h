@@ -0,0 +1,94 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+struct LogRecord;
+
+
+// ***************************************************************************
+
+/**
+ * Output layout of a log line, compiled from a pattern
+ *
+ * The pattern is parsed once into a list of operations. Rendering a
+ * record just walks this list, copying strings and converting integers
+ * directly into the output buffer.
+ *
+ * Pattern elements:
+ * - `%U`  uptime as seconds.milliseconds (e.g. `12.345`)
+ * - `%u`  uptime in milliseconds
+ * - `%T`  UTC wall clock time (e.g. `2022-01-04T11:30:00Z`)
+ * - `%L`  level as two digit number (e.g. `20`)
+ * - `%N`  level name (e.g. `INFO`)
+ * - `%P`  syslog priority (facility and severity)
+ * - `%d`  device id
+ * - `%t`  tag
+ * - `%k`  task (thread) name
+ * - `%m`  message
+ * - `%C`  start of the level color (if color is enabled)
+ * - `%c`  end of the level color (if color is enabled)
+ * - `%%`  a percent sign
+ *
+ * With a `-` flag (e.g. `%-t`), an empty string field is rendered as
+ * `-` (the RFC 5424 NILVALUE). All other characters are copied.
+ */
+class LogLayout
+{
+public:
+    /**
+     * Values for the line which are not part of the LogRecord
+     */
+    struct Context
+    {
+        const char* deviceId;
+        const char* colorStart;
+        const char* colorEnd;
+        time_t time;   ///< wall clock time for `%T`
+        int pri;       ///< syslog priority for `%P`
+    };
+
+    /**
+     * Compile the pattern. Unknown elements are copied literally.
+     */
+    explicit LogLayout(const char* pattern);
+
+    /**
+     * `true` if the layout contains `%T`, i.e. Context::time is used.
+     */
+    bool needsTime() const { return _needsTime; }
+
+    /**
+     * Render a record into buf.
+     * @return length of the output; it is truncated to size-1 characters
+     *         and always 0-terminated.
+     */
+    int render(char* buf, int size, const LogRecord& record, const Context& context) const;
+
+private:
+    enum class OpCode : uint8_t
+    {
+        LITERAL, UPTIME, UPTIME_MS, TIME, LEVEL, LEVEL_NAME, PRI,
+        DEVICE, TAG, TASK, MESSAGE, COLOR_START, COLOR_END,
+    };
+    struct Op
+    {
+        OpCode code;
+        bool nil;         ///< render empty strings as "-"
+        uint16_t offset;  ///< LITERAL: position in _literals
+        uint16_t length;  ///< LITERAL: length
+    };
+
+    std::vector<Op> _ops;
+    std::string _literals;
+    bool _needsTime;
+};
+
+// ***************************************************************************
@@ -5,10 +5,39 @@
 
 #include <cstdint>
 
+// logger.h decides between the platforms (see LOGGER32_POSIX)
+#include "logger.h"
+#include "log_format.h"
+
+#ifdef ARDUINO
 #include <Arduino.h>
+#endif
+#ifdef ESP_PLATFORM
 #include <freertos/FreeRTOS.h>
-
-#include "logger.h"
+#include <freertos/task.h>
+#include <esp_pthread.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#if __has_include(<esp_mac.h>)
+#include <esp_mac.h>
+#endif
+#if __has_include(<esp_idf_version.h>)
+#include <esp_idf_version.h>
+#endif
+// esp_idf_version.h, thread names and default pthread configs came with IDF 4.0
+#if defined(ESP_IDF_VERSION_VAL)
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 0, 0)
+#define LOGGER32_PTHREAD_NAMES
+#endif
+#endif
+#endif
+#ifdef LOGGER32_POSIX
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 
 // ***************************************************************************
@@ -25,13 +54,37 @@ const char* LogHandler::_COLOR_STRINGS[] =
     /*5:CRITICAL*/ "\u001b[35m", // magenta
 };
 
-LogHandler::LogHandler(bool color):
+LogHandler::LogHandler(bool color, const char* layout):
     _color(color),
+    _layout(layout),
     _deviceId(nullptr)
 {
+    #if defined(ARDUINO)
     const int ID_MAXLEN = 4+6*2+1;
     static char id_buf[ID_MAXLEN];
     snprintf(id_buf, ID_MAXLEN-1, "e32-%06llx", ESP.getEfuseMac());
+    #elif defined(ESP_PLATFORM)
+    // same id as with ESP.getEfuseMac() on Arduino
+    const int ID_MAXLEN = 4+6*2+1;
+    static char id_buf[ID_MAXLEN];
+    uint8_t mac[6];
+    unsigned long long macId = 0;
+    if (esp_efuse_mac_get_default(mac) == ESP_OK)
+    {
+        for (int i = 5; i >= 0; i--)
+        {
+            macId = (macId << 8) | mac[i];
+        }
+    }
+    snprintf(id_buf, ID_MAXLEN-1, "e32-%06llx", macId);
+    #else
+    const int ID_MAXLEN = 64;
+    static char id_buf[ID_MAXLEN];
+    if (gethostname(id_buf, ID_MAXLEN-1) != 0)
+    {
+        snprintf(id_buf, ID_MAXLEN-1, "host-%ld", (long) gethostid());
+    }
+    #endif
     _deviceId = id_buf;
 }
 
@@ -44,9 +97,10 @@ const char* LogHandler::colorStartStr(Logger::LogLevel level) const
 
     // determine color
     int color_index = ((int) level) / 10;
-    if (color_index >= sizeof(_COLOR_STRINGS))
+    const int count = sizeof(_COLOR_STRINGS) / sizeof(_COLOR_STRINGS[0]);
+    if (color_index >= count)
     {
-        color_index = sizeof(_COLOR_STRINGS) - 1;
+        color_index = count - 1;
     }
     return _COLOR_STRINGS[color_index];
 }
@@ -60,40 +114,144 @@ const char* LogHandler::colorEndStr() const
     return _COLOR_STRINGS[0];
 }
 
+int LogHandler::formatLine(char* buf, int size, const LogRecord& record, time_t wallTime, int pri) const
+{
+    LogLayout::Context context;
+    context.deviceId = _deviceId;
+    context.colorStart = colorStartStr(record.level);
+    context.colorEnd = colorEndStr();
+    context.time = wallTime != 0 ? wallTime : record.time;
+    context.pri = pri;
+    if (context.time == 0 && _layout.needsTime())
+    {
+        time(&context.time);
+    }
+    return _layout.render(buf, size, record, context);
+}
+
+std::thread LogHandler::startWorker(const char* name, size_t stackSize, std::function<void()> fn)
+{
+    #if defined(LOGGER32_PTHREAD_NAMES)
+    // std::thread is built on pthreads, which are configured per creating task
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.thread_name = name;
+    cfg.stack_size = stackSize;
+    esp_pthread_set_cfg(&cfg);
+    std::thread thread(std::move(fn));
+    cfg = esp_pthread_get_default_config();
+    esp_pthread_set_cfg(&cfg);
+    return thread;
+    #elif defined(ESP_PLATFORM)
+    // IDF 3.x has neither default configs nor thread names, only the stack size is set
+    (void) name;
+    esp_pthread_cfg_t previous = {};
+    bool hadCfg = esp_pthread_get_cfg(&previous) == ESP_OK;
+    esp_pthread_cfg_t cfg = {};
+    cfg.stack_size = stackSize;
+    cfg.prio = hadCfg ? previous.prio : CONFIG_ESP32_PTHREAD_TASK_PRIO_DEFAULT;
+    esp_pthread_set_cfg(&cfg);
+    std::thread thread(std::move(fn));
+    if (!hadCfg)
+    {
+        previous.stack_size = CONFIG_ESP32_PTHREAD_TASK_STACK_SIZE_DEFAULT;
+        previous.prio = CONFIG_ESP32_PTHREAD_TASK_PRIO_DEFAULT;
+    }
+    esp_pthread_set_cfg(&previous);
+    return thread;
+    #elif defined(LOGGER32_POSIX)
+    // the name shows up in currentTaskName() and in tools like top -H
+    (void) stackSize;
+    std::string threadName(name, strnlen(name, 15));
+    return std::thread([threadName, fn]() {
+        pthread_setname_np(pthread_self(), threadName.c_str());
+        fn();
+    });
+    #else
+    (void) name;
+    (void) stackSize;
+    return std::thread(std::move(fn));
+    #endif
+}
+
+const char* LogHandler::currentTaskName()
+{
+    #if defined(ESP_PLATFORM)
+    return pcTaskGetTaskName(NULL);
+    #elif defined(LOGGER32_POSIX)
+    static thread_local char name[16];
+    if (pthread_getname_np(pthread_self(), name, sizeof(name)) != 0)
+    {
+        return nullptr;
+    }
+    return name;
+    #else
+    return nullptr;
+    #endif
+}
+
+unsigned long LogHandler::uptimeMs()
+{
+    #if defined(ARDUINO)
+    return millis();
+    #elif defined(ESP_PLATFORM)
+    return (unsigned long) (esp_timer_get_time() / 1000);
+    #else
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    #endif
+}
+
+void LogHandler::write(Logger::LogLevel level, const char *tag, const char* format, va_list ap)
+{
+    char message[MESSAGE_BUFLEN];
+    logVsnprintf(message, MESSAGE_BUFLEN, format, ap);
+
+    LogRecord record;
+    record.level = level;
+    record.tag = tag;
+    record.task = currentTaskName();
+    record.ms = uptimeMs();
+    time(&record.time);
+    record.message = message;
+    writeRecord(record);
+}
+
+void LogHandler::writeRecord(const LogRecord& record)
+{
+    writef(record.level, record.tag, "%s", record.message);
+}
+
+void LogHandler::writef(Logger::LogLevel level, const char *tag, const char* format...)
+{
+    va_list args;
+    va_start(args, format);
+    write(level, tag, format, args);
+    va_end(args);
+}
+
 // ***************************************************************************
 
+#ifdef ARDUINO
+
 SerialLogHandler::SerialLogHandler(bool color, unsigned long baudRate):
     LogHandler(color)
 {
     if (baudRate > 0)
     {
-        #ifdef ARDUINO
         Serial.begin(baudRate);
-        #endif
     }
 }
 
-void SerialLogHandler::write(Logger::LogLevel level, const char *tag, const char* format, va_list ap)
+void SerialLogHandler::writeRecord(const LogRecord& record)
 {
-    unsigned long ms = millis();
-    //ms = xTaskGetTickCount() * (1000 / configTICK_RATE_HZ);
-    //const char* task = pcTaskGetTaskName(NULL);
-
-    Serial.print(colorStartStr(level));
-    Serial.printf("%lu.%03lu:%02d:%s:%s:", 
-        ms / 1000, ms % 1000, 
-        static_cast<int>(level),
-        _deviceId == nullptr ? "" : _deviceId,
-//        task == NULL ? "" : task,
-        tag == nullptr ? "" : tag);
-
-    constexpr int BUFLEN = 256;
-    char buffer[BUFLEN];
-    vsnprintf(buffer, BUFLEN-1, format, ap);
-    Serial.print(buffer);
-    Serial.println(colorEndStr());
+    char line[LINE_BUFLEN];
+    formatLine(line, LINE_BUFLEN, record);
+    Serial.println(line);
 }
 
+#endif
+
 // ***************************************************************************
 
 Logger::Logger(const char* tag, LogHandler* logHandlerPtr):
@@ -137,6 +295,14 @@ void Logger::logv(LogLevel level, const char* format, va_list ap) const
     }
 }
 
+void Logger::writev(LogLevel level, const char* format, va_list ap) const
+{
+    if (_logHandlerPtr != nullptr)
+    {
+        _logHandlerPtr->write(level, _tag, format, ap);
+    }
+}
+
 void Logger::logf(LogLevel level, const char* format...) const
 {
     va_list args;
@@ -7,7 +7,17 @@
 
 #include <cstdio>
 #include <cstdarg>
+#include <cstddef>
+#include <functional>
+#include <thread>
 
+#include "log_layout.h"
+
+// Arduino-ESP32 and plain ESP-IDF both define ESP_PLATFORM and run on
+// FreeRTOS, only builds with neither are POSIX hosts.
+#if !defined(ARDUINO) && !defined(ESP_PLATFORM)
+#define LOGGER32_POSIX
+#endif
 
 // ***************************************************************************
 
@@ -60,6 +70,11 @@ public:
      */
     const char* getTag() const { return _tag; }
 
+    /**
+     * Get the LogHandler used for output
+     */
+    LogHandler* getLogHandler() const { return _logHandlerPtr; }
+
     /**
      * Set log level, all output with a lower level is discarded.
      */
@@ -89,6 +104,12 @@ public:
      */
     void logv(LogLevel level, const char* format, va_list ap) const;
 
+    /**
+     * Log output with given level, format and arguments referenced by ap,
+     * regardless of the log level (e.g. for LOG_DYNAMIC_DEBUG()).
+     */
+    void writev(LogLevel level, const char* format, va_list ap) const;
+
     /**
      * Log output with given level, format and printf()-style arguments.
      */
@@ -110,6 +131,25 @@ private:
 
 // ***************************************************************************
 
+/**
+ * A log message after formatting, together with its meta data
+ *
+ * Records are used to hand messages on after the printf()-style arguments
+ * of the log call are gone, e.g. to another thread. The timestamps and the
+ * task name are captured in the context of the log call.
+ */
+struct LogRecord
+{
+    Logger::LogLevel level;
+    const char* tag;
+    const char* task;
+    unsigned long ms;
+    time_t time;        ///< wall clock time of the log call, 0 if unknown
+    const char* message;
+};
+
+// ***************************************************************************
+
 /**
  * Abstract base class LogHandler for formatting and writing logs to some output
  *
@@ -125,11 +165,17 @@ private:
 class LogHandler
 {
 public:
+    /**
+     * Default layout of the log lines, e.g. `12.345:20:e32-a1b2c3:main:message`
+     */
+    static constexpr const char* DEFAULT_LAYOUT = "%C%U:%L:%d:%t:%m%c";
+
     /**
      * Construct a LogHandler 
      * @param color  If `true`, use ANSI colors in the log output.
+     * @param layout  Layout pattern of the log lines, see LogLayout.
      */
-    LogHandler(bool color = true);
+    LogHandler(bool color = true, const char* layout = DEFAULT_LAYOUT);
     virtual ~LogHandler() {}
 
     /**
@@ -158,14 +204,76 @@ public:
      */
     const char* getDeviceId() const { return _deviceId; };
 
-    virtual void write(Logger::LogLevel level, const char *tag, const char* format, va_list ap) = 0;
+    /**
+     * Set the layout of the log lines (see LogLayout for the pattern).
+     * 
+     * The pattern is compiled once here. Set the layout before logging
+     * to this LogHandler.
+     */
+    void setLayout(const char* pattern) { _layout = LogLayout(pattern); }
+
+    /**
+     * Write a log message given as format and arguments.
+     *
+     * The default implementation formats the message into a LogRecord
+     * and passes it on to writeRecord(). A concrete LogHandler must
+     * override at least one of write() and writeRecord().
+     */
+    virtual void write(Logger::LogLevel level, const char *tag, const char* format, va_list ap);
+
+    /**
+     * Write an already formatted log message.
+     *
+     * The default implementation passes the message on to write().
+     */
+    virtual void writeRecord(const LogRecord& record);
+
+    /**
+     * Maximum length of a formatted message including the terminating 0.
+     */
+    static constexpr int MESSAGE_BUFLEN = 256;
+
+    /**
+     * Maximum length of a log line rendered with the layout including the terminating 0.
+     */
+    static constexpr int LINE_BUFLEN = 384;
+
+    /**
+     * Milliseconds since startup (`millis()` on Arduino), the time base of LogRecord::ms.
+     */
+    static unsigned long uptimeMs();
 
 protected:
     const char* colorStartStr(Logger::LogLevel level) const;
     const char* colorEndStr() const;
 
+    /**
+     * Render record with the layout of this LogHandler.
+     * @param wallTime  Wall clock time for the layout, 0 for the time of
+     *                  the record or, if unknown, now.
+     * @param pri  Syslog priority for the layout.
+     * @return length of the line in buf, see LogLayout::render().
+     */
+    int formatLine(char* buf, int size, const LogRecord& record, time_t wallTime = 0, int pri = -1) const;
+
+    /**
+     * Start a worker thread for a LogHandler doing its output in the background.
+     * @param name  Name of the thread (visible in the task list on ESP-IDF).
+     * @param stackSize  Stack size in bytes, used on ESP-IDF only.
+     * @param fn  Function executed by the thread.
+     */
+    static std::thread startWorker(const char* name, size_t stackSize, std::function<void()> fn);
+
+    /**
+     * Name of the calling task (FreeRTOS) or thread (POSIX), or nullptr if not available.
+     */
+    static const char* currentTaskName();
+
 private:
+    void writef(Logger::LogLevel level, const char *tag, const char* format...);
+
     bool _color;
+    LogLayout _layout;
     static const char* _EMPTY_STRING;
     static const char* _COLOR_STRINGS[];
 protected:
@@ -174,8 +282,12 @@ protected:
 
 // ***************************************************************************
 
+#ifdef ARDUINO
+
 /**
  * Concrete LogHandler for the serial interface
+ *
+ * On POSIX systems, use FdLogHandler instead.
  */
 class SerialLogHandler: public LogHandler
 {
@@ -187,10 +299,12 @@ public:
      */
     SerialLogHandler(bool color = true, unsigned long baudRate = 0);
 
-    virtual void write(Logger::LogLevel level, const char *tag, const char* format, va_list ap);
+    virtual void writeRecord(const LogRecord& record);
 
 };
 
+#endif
+
 // ***************************************************************************
 
 /**
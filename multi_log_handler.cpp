@@ -3,11 +3,176 @@
  * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
  */
 
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
 
 #include "multi_log_handler.h"
 
 
+// ***************************************************************************
+
+namespace {
+
+/**
+ * A LogRecord owning copies of its strings, shared between the sink queues
+ *
+ * The tag is not copied, it has to stay available anyway (see Logger).
+ */
+struct SharedRecord
+{
+    SharedRecord(const LogRecord& r):
+        record(r),
+        task(r.task == nullptr ? "" : r.task),
+        message(r.message == nullptr ? "" : r.message)
+    {
+        record.task = r.task == nullptr ? nullptr : task.c_str();
+        record.message = message.c_str();
+    }
+
+    LogRecord record;
+    std::string task;
+    std::string message;
+};
+
+}
+
+// ***************************************************************************
+
+class MultiLogHandler::Sink
+{
+public:
+    Sink(LogHandler* logHandlerPtr, size_t queueLength, DropPolicy dropPolicy):
+        _logHandlerPtr(logHandlerPtr),
+        _queueLength(queueLength),
+        _dropPolicy(dropPolicy),
+        _stats{0, 0, 0, 0},
+        _stop(false),
+        _busy(false)
+    {
+    }
+
+    ~Sink()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _notEmpty.notify_all();
+        _notFull.notify_all();
+        if (_worker.joinable())
+        {
+            _worker.join();
+        }
+    }
+
+    LogHandler* logHandlerPtr() const { return _logHandlerPtr; }
+    bool isAsync() const { return _queueLength > 0; }
+
+    SinkStats stats() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        SinkStats stats = _stats;
+        stats.queueDepth = _queue.size();
+        return stats;
+    }
+
+    void write(const LogRecord& record)
+    {
+        _logHandlerPtr->writeRecord(record);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.written++;
+    }
+
+    void enqueue(const std::shared_ptr<const SharedRecord>& recordPtr)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_queue.size() >= _queueLength)
+        {
+            switch (_dropPolicy)
+            {
+            case DropPolicy::DROP_NEWEST:
+                _stats.dropped++;
+                return;
+            case DropPolicy::DROP_OLDEST:
+                _queue.pop_front();
+                _stats.dropped++;
+                break;
+            case DropPolicy::BLOCK:
+                _notFull.wait(lock, [this]() { return _queue.size() < _queueLength || _stop; });
+                if (_stop)
+                {
+                    return;
+                }
+                break;
+            }
+        }
+        _queue.push_back(recordPtr);
+        if (_queue.size() > _stats.maxQueueDepth)
+        {
+            _stats.maxQueueDepth = _queue.size();
+        }
+        _notEmpty.notify_one();
+    }
+
+    /**
+     * Wait until the queue is empty and the worker is not in the child.
+     */
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _drained.wait(lock, [this]() { return _queue.empty() && !_busy; });
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true)
+        {
+            _notEmpty.wait(lock, [this]() { return !_queue.empty() || _stop; });
+            if (_queue.empty())
+            {
+                // stopped and drained
+                break;
+            }
+            std::shared_ptr<const SharedRecord> recordPtr = std::move(_queue.front());
+            _queue.pop_front();
+            _busy = true;
+            _notFull.notify_one();
+
+            lock.unlock();
+            _logHandlerPtr->writeRecord(recordPtr->record);
+            recordPtr.reset();
+            lock.lock();
+            _busy = false;
+            _stats.written++;
+            if (_queue.empty())
+            {
+                _drained.notify_all();
+            }
+        }
+    }
+
+    void setWorker(std::thread worker) { _worker = std::move(worker); }
+
+private:
+    LogHandler* _logHandlerPtr;
+    size_t _queueLength;
+    DropPolicy _dropPolicy;
+    SinkStats _stats;
+    bool _stop;
+    bool _busy;  ///< the worker is writing a record to the child
+    std::deque<std::shared_ptr<const SharedRecord>> _queue;
+    mutable std::mutex _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+    std::condition_variable _drained;
+    std::thread _worker;
+};
+
 // ***************************************************************************
 
 MultiLogHandler::MultiLogHandler():
@@ -15,17 +180,76 @@ MultiLogHandler::MultiLogHandler():
 {
 }
 
-void MultiLogHandler::write(Logger::LogLevel level, const char *tag, const char* format, va_list ap)
+MultiLogHandler::~MultiLogHandler()
 {
-    for (auto &&it : _logHandlerPtrs)
+    // the sinks stop their workers after their queues are drained
+    _sinks.clear();
+}
+
+void MultiLogHandler::addLogHandler(LogHandler *logHandlerPtr)
+{
+    if (logHandlerPtr != nullptr)
+    {
+        _sinks.emplace_back(new Sink(logHandlerPtr, 0, DropPolicy::DROP_NEWEST));
+    }
+}
+
+void MultiLogHandler::addAsyncLogHandler(LogHandler *logHandlerPtr, size_t queueLength,
+    DropPolicy dropPolicy, size_t stackSize)
+{
+    if (logHandlerPtr == nullptr)
+    {
+        return;
+    }
+    if (queueLength == 0)
     {
-        if (it != nullptr)
+        queueLength = 1;
+    }
+    Sink* sink = new Sink(logHandlerPtr, queueLength, dropPolicy);
+    _sinks.emplace_back(sink);
+    sink->setWorker(startWorker("multilog", stackSize, [sink]() { sink->run(); }));
+}
+
+MultiLogHandler::SinkStats MultiLogHandler::getStats(const LogHandler *logHandlerPtr) const
+{
+    for (auto &&it : _sinks)
+    {
+        if (it->logHandlerPtr() == logHandlerPtr)
         {
-            it->write(level, tag, format, ap);
+            return it->stats();
         }
     }
-    
+    return SinkStats{0, 0, 0, 0};
 }
 
-// ***************************************************************************
+void MultiLogHandler::flush()
+{
+    for (auto &&it : _sinks)
+    {
+        if (it->isAsync())
+        {
+            it->flush();
+        }
+    }
+}
 
+void MultiLogHandler::writeRecord(const LogRecord& record)
+{
+    // the shared copy is only created if there are asynchronous sinks
+    std::shared_ptr<const SharedRecord> sharedPtr;
+    for (auto &&it : _sinks)
+    {
+        if (!it->isAsync())
+        {
+            it->write(record);
+            continue;
+        }
+        if (!sharedPtr)
+        {
+            sharedPtr = std::make_shared<const SharedRecord>(record);
+        }
+        it->enqueue(sharedPtr);
+    }
+}
+
+// ***************************************************************************
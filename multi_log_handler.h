@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "logger.h"
@@ -14,17 +15,71 @@
 
 /**
  * Concrete LogHandler for output to multiple other log handlers
+ *
+ * The message is formatted once by the caller and then passed to all
+ * child log handlers. Children added with addLogHandler() are called
+ * one after another in the context of the caller. Children added with
+ * addAsyncLogHandler() get their own bounded queue and worker thread,
+ * so a slow child (e.g. a SyslogHandler waiting for the network) does
+ * not delay the caller or the other children. The formatted message is
+ * shared by reference counting between the queues.
  */
 class MultiLogHandler: public LogHandler
 {
 public:
+    /**
+     * What to do with a message for an asynchronous child whose queue is full
+     */
+    enum class DropPolicy { DROP_NEWEST, DROP_OLDEST, BLOCK };
+
+    /**
+     * Counters of a child log handler
+     */
+    struct SinkStats
+    {
+        size_t queueDepth;      ///< messages currently waiting in the queue
+        size_t maxQueueDepth;   ///< highest queue depth seen so far
+        unsigned long written;  ///< messages passed to the child log handler
+        unsigned long dropped;  ///< messages dropped because the queue was full
+    };
+
     MultiLogHandler();
-    void addLogHandler(LogHandler *logHandlerPtr) { _logHandlerPtrs.push_back(logHandlerPtr); }
+    virtual ~MultiLogHandler();
+
+    /**
+     * Add a child log handler called synchronously by the caller.
+     */
+    void addLogHandler(LogHandler *logHandlerPtr);
+
+    /**
+     * Add a child log handler with its own queue and worker thread.
+     * @param logHandlerPtr  Pointer to the child log handler.
+     * @param queueLength  Maximum number of messages waiting for the child.
+     * @param dropPolicy  What to do if the queue is full: discard the new
+     *                    message, discard the oldest message in the queue or
+     *                    block the caller until there is room.
+     * @param stackSize  Stack size of the worker thread (ESP-IDF only).
+     */
+    void addAsyncLogHandler(LogHandler *logHandlerPtr, size_t queueLength = 16,
+        DropPolicy dropPolicy = DropPolicy::DROP_NEWEST, size_t stackSize = 4096);
+
+    /**
+     * Get the counters for a child log handler (all zero if not found).
+     */
+    SinkStats getStats(const LogHandler *logHandlerPtr) const;
+
+    /**
+     * Wait until the queues of the asynchronous children are empty and
+     * their last records are written, e.g. before closing their outputs.
+     * This waits for stalled children as well.
+     */
+    void flush();
 
-    virtual void write(Logger::LogLevel level, const char *tag, const char* format, va_list ap);
+    virtual void writeRecord(const LogRecord& record);
 
 private:
-    std::vector<LogHandler *> _logHandlerPtrs;
+    class Sink;
+    std::vector<std::unique_ptr<Sink>> _sinks;
 };
 
 // ***************************************************************************
@@ -5,15 +5,24 @@
 
 #include <cstdint>
 
-//#ifdef ARDUINO
+#ifdef ARDUINO
 #include <Arduino.h>
 #include <WiFi.h>
 #include <freertos/FreeRTOS.h>
-//#else
-//    #error "Architecture/Framework is not supported. Supported: ESP32 (IDF and Arduino)"
-//#endif
+#else
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/uio.h>
+#endif
+#endif
 
 #include "syslog_handler.h"
+#include "log_format.h"
 
 
 // ***************************************************************************
@@ -28,64 +37,301 @@ const int SyslogHandler::_LEVEL_MAPPING[] =
     /*5:CRITICAL*/ 2, // 2=critical, 1=alert, 0=emergency
 };
 
-SyslogHandler::SyslogHandler(bool color, String hostname, int port):
-    LogHandler(color),
+#ifdef ARDUINO
+
+SyslogHandler::SyslogHandler(bool color, String hostname, int port,
+        size_t backlogSize, const char* spillPath, size_t spillMaxSize):
+    LogHandler(color, DEFAULT_SYSLOG_LAYOUT),
     _hostname(hostname),
     _port(port),
-    _wifiUdp()
+    _wifiUdp(),
+    _backlog(backlogSize, spillPath, spillMaxSize),
+    _replayBatchSize(8),
+    _replayIntervalMs(100),
+    _lastReplayMs(0)
+{
+}
+
+bool SyslogHandler::isConnected()
 {
+    return WiFi.status() == WL_CONNECTED;
 }
 
-// syslog from https://www.rfc-editor.org/info/rfc5424
-// <PRI>1 TIMESTAMP HOSTNAME APPNAME PROCID MSGID MSG
-void SyslogHandler::write(Logger::LogLevel level, const char *tag, const char* format, va_list ap)
+void SyslogHandler::transmit(const char* msg, int msgLen)
 {
-    if (WiFi.status() != WL_CONNECTED)
+    if (_wifiUdp.beginPacket(_hostname.c_str(), _port))
+    {
+        _wifiUdp.write((const uint8_t*) msg, msgLen);
+        _wifiUdp.endPacket();
+    }
+}
+
+#else
+
+SyslogHandler::SyslogHandler(bool color, const std::string& hostname, int port,
+        size_t backlogSize, const char* spillPath, size_t spillMaxSize):
+    LogHandler(color, DEFAULT_SYSLOG_LAYOUT),
+    _hostname(hostname),
+    _port(port),
+    _socket(-1),
+    _lastOpenMs(0),
+    _maxPending(_DEFAULT_MAX_PENDING),
+    _blockWhenFull(false),
+    _stop(false),
+    _droppedCount(0),
+    _unreportedDrops(0),
+    _backlog(backlogSize, spillPath, spillMaxSize),
+    _replayBatchSize(8),
+    _replayIntervalMs(100),
+    _lastReplayMs(0)
+{
+    openSocket();
+    _sender = startWorker("syslog", 4096, [this]() { senderLoop(); });
+}
+
+SyslogHandler::~SyslogHandler()
+{
+    {
+        std::lock_guard<std::mutex> lock(_senderMutex);
+        _stop = true;
+    }
+    _senderCond.notify_one();
+    _spaceCond.notify_all();
+    if (_sender.joinable())
+    {
+        _sender.join();
+    }
+    if (_socket >= 0)
+    {
+        close(_socket);
+    }
+}
+
+void SyslogHandler::openSocket()
+{
+    _lastOpenMs = uptimeMs();
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* result;
+    std::string port = std::to_string(_port);
+    if (getaddrinfo(_hostname.c_str(), port.c_str(), &hints, &result) != 0)
     {
         return;
     }
-    unsigned long ms = millis();
+    for (struct addrinfo* ai = result; ai != nullptr; ai = ai->ai_next)
+    {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        // a connected UDP socket needs no address per datagram
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            _socket = fd;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(result);
+}
 
-    // pri = facility + level
-    int level_index = ((int) level) / 10;
-    if (level_index >= sizeof(_LEVEL_MAPPING))
+bool SyslogHandler::isConnected()
+{
+    if (_socket < 0 && uptimeMs() - _lastOpenMs >= 1000)
     {
-        level_index = sizeof(_LEVEL_MAPPING) - 1;
+        openSocket();
     }
-    int pri = _FACILITY*8 + _LEVEL_MAPPING[level_index];
+    return _socket >= 0;
+}
 
-    // determine the time in (Zulu/UTC)
-    time_t now;
-    time(&now);
-    struct tm timeinfo;
-    gmtime_r(&now, &timeinfo);
-    char time_str[64];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+void SyslogHandler::setSendQueue(size_t maxPending, bool block)
+{
+    std::lock_guard<std::mutex> lock(_senderMutex);
+    _maxPending = maxPending > 0 ? maxPending : 1;
+    _blockWhenFull = block;
+}
 
-    // determine the task name
-    const char* task = pcTaskGetTaskName(NULL);
+void SyslogHandler::transmit(const char* msg, int msgLen)
+{
+    {
+        std::unique_lock<std::mutex> lock(_senderMutex);
+        if (_pending.size() >= _maxPending && _blockWhenFull)
+        {
+            _spaceCond.wait(lock, [this]() { return _pending.size() < _maxPending || _stop; });
+        }
+        if (_pending.size() >= _maxPending)
+        {
+            // reported by replay() with the next message
+            _droppedCount++;
+            _unreportedDrops++;
+            return;
+        }
+        _pending.emplace_back();
+        Datagram& datagram = _pending.back();
+        datagram.len = msgLen;
+        memcpy(datagram.data, msg, msgLen);
+    }
+    _senderCond.notify_one();
+}
 
-    // create the log string
-    constexpr int BUFLEN = 256;
-    char msg[BUFLEN];
-    int msgLen = snprintf(msg, BUFLEN-1, 
-        "<%d>1 %s %s %s %s %lu.%03lu %s",
-        pri, 
-        time_str, 
-        _deviceId == nullptr ? "-" : _deviceId,
-        tag == nullptr ? "-" : tag,
-        task == NULL ? "-" : task,
-        ms / 1000, ms % 1000, 
-        colorStartStr(level));
-    msgLen += vsnprintf(&msg[msgLen], BUFLEN-1-msgLen, format, ap);
-    msgLen += snprintf(&msg[msgLen], BUFLEN-1-msgLen, colorEndStr());
+void SyslogHandler::senderLoop()
+{
+    std::unique_lock<std::mutex> lock(_senderMutex);
+    while (true)
+    {
+        _senderCond.wait(lock, [this]() { return !_pending.empty() || _stop; });
+        if (_pending.empty())
+        {
+            // stopped and drained
+            break;
+        }
+        // datagrams queued while sending make up the next batch
+        _sending.swap(_pending);
+        _spaceCond.notify_all();
+        lock.unlock();
+        sendBatch(_sending);
+        _sending.clear();
+        lock.lock();
+    }
+}
 
-    //printf("%s\n", msg);
-    if (_wifiUdp.beginPacket(_hostname.c_str(), _port))
+void SyslogHandler::sendBatch(const std::vector<Datagram>& batch)
+{
+    #ifdef __linux__
+    constexpr size_t MAX_BATCH = 64;
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iovs[MAX_BATCH];
+    size_t pos = 0;
+    while (pos < batch.size())
     {
-        _wifiUdp.write((const uint8_t*) msg, msgLen);
-        _wifiUdp.endPacket();
+        size_t n = std::min(MAX_BATCH, batch.size() - pos);
+        memset(msgs, 0, n * sizeof(msgs[0]));
+        for (size_t i = 0; i < n; i++)
+        {
+            iovs[i].iov_base = const_cast<char*>(batch[pos + i].data);
+            iovs[i].iov_len = batch[pos + i].len;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int sent = sendmmsg(_socket, msgs, n, 0);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            // e.g. ECONNREFUSED from a previous datagram, skip this one
+            sent = 1;
+        }
+        pos += sent;
+    }
+    #else
+    for (const Datagram& datagram : batch)
+    {
+        ::send(_socket, datagram.data, datagram.len, 0);
+    }
+    #endif
+}
+
+#endif
+
+void SyslogHandler::writeRecord(const LogRecord& record)
+{
+    // the time of the log call, this may run later on a MultiLogHandler worker
+    time_t now = record.time;
+    if (now == 0)
+    {
+        time(&now);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!isConnected())
+    {
+        _backlog.push(record, now);
+        return;
+    }
+    send(record, now);
+    replay();
+}
+
+void SyslogHandler::flushBacklog()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (isConnected())
+    {
+        replay();
+    }
+}
+
+void SyslogHandler::replay()
+{
+    unsigned long now = uptimeMs();
+
+    // report the losses first, they are older than anything in the backlog
+    unsigned long dropped = _backlog.takeDroppedCount();
+    if (dropped > 0)
+    {
+        sendNotice("%lu messages dropped while offline", dropped);
     }
+#ifndef ARDUINO
+    {
+        // wait for room, the notice itself must not be dropped
+        std::lock_guard<std::mutex> lock(_senderMutex);
+        dropped = _pending.size() < _maxPending ? _unreportedDrops : 0;
+        _unreportedDrops -= dropped;
+    }
+    if (dropped > 0)
+    {
+        sendNotice("%lu messages dropped, send queue full", dropped);
+    }
+#endif
+
+    if (_backlog.empty() || now - _lastReplayMs < _replayIntervalMs)
+    {
+        return;
+    }
+    _lastReplayMs = now;
+    for (unsigned i = 0; i < _replayBatchSize && _backlog.pop(_entry); i++)
+    {
+        send(_entry.record, _entry.time);
+    }
+}
+
+void SyslogHandler::sendNotice(const char* format, unsigned long count)
+{
+    char message[64];
+    logSnprintf(message, sizeof(message), format, count);
+    LogRecord notice;
+    notice.level = Logger::LogLevel::WARNING;
+    notice.tag = "syslog";
+    notice.task = currentTaskName();
+    notice.ms = uptimeMs();
+    time(&notice.time);
+    notice.message = message;
+    send(notice, notice.time);
+}
+
+void SyslogHandler::send(const LogRecord& record, time_t now)
+{
+    // pri = facility + level
+    int level_index = ((int) record.level) / 10;
+    const int count = sizeof(_LEVEL_MAPPING) / sizeof(_LEVEL_MAPPING[0]);
+    if (level_index >= count)
+    {
+        level_index = count - 1;
+    }
+    int pri = _FACILITY*8 + _LEVEL_MAPPING[level_index];
+
+    // create the log string
+    char msg[LINE_BUFLEN];
+    int msgLen = formatLine(msg, LINE_BUFLEN, record, now, pri);
+
+    //printf("%s\n", msg);
+    transmit(msg, msgLen);
 
     // Timing measurements 22-01-04 11:30:
     // - printf(), but no UDP output: 6.8 ms/call
@@ -5,33 +5,147 @@
 
 #pragma once
 
+#include <mutex>
+
+#ifdef ARDUINO
 #include <WiFiUdp.h>
+#else
+#include <atomic>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+#endif
 
 #include "logger.h"
+#include "log_backlog.h"
 
 
 // ***************************************************************************
 
 /**
  * Concrete LogHandler for a syslog server via UDP
+ *
+ * While WiFi is not connected, messages are kept in a bounded backlog
+ * (see LogBacklog). After the connection is back, the number of dropped
+ * messages is reported and the backlog is replayed with the original
+ * timestamps in batches of replayBatchSize messages every
+ * replayIntervalMs. Replay happens along with new messages and in
+ * flushBacklog(), which should be called regularly (e.g. from loop()).
+ *
+ * Without Arduino (POSIX hosts and ESP-IDF with lwIP), the handler uses
+ * a UDP socket instead of WiFi and counts as connected once the server
+ * address is resolved. Datagrams are queued and sent by a worker thread,
+ * in batches via sendmmsg() on Linux. If the queue is full, datagrams
+ * are dropped and reported with the next message, or the caller waits
+ * (see setSendQueue()).
  */
 class SyslogHandler: public LogHandler
 {
 public:
+    /**
+     * Default layout following RFC 5424 (https://www.rfc-editor.org/info/rfc5424):
+     * `<PRI>1 TIMESTAMP HOSTNAME APPNAME PROCID MSGID MSG` with the tag as
+     * APPNAME, the task as PROCID and the uptime as MSGID.
+     */
+    static constexpr const char* DEFAULT_SYSLOG_LAYOUT = "<%P>1 %T %-d %-t %-k %U %C%m%c";
+
     /**
      * Construct a SyslogLogHandler 
      * @param color  If `true`, use ANSI colors in the log output.
      * @param hostname  Name or ip address of the syslog server
      * @param port  Port of the syslog server
+     * @param backlogSize  RAM for messages while offline (bytes), 0 to disable.
+     * @param spillPath  File for backlog overflow (e.g. "/littlefs/syslog.bak")
+     *                   or nullptr to drop the oldest messages instead.
+     * @param spillMaxSize  Maximum size of the spill file (bytes).
+     */
+#ifdef ARDUINO
+    SyslogHandler(bool color, String hostname, int port,
+        size_t backlogSize = 4096, const char* spillPath = nullptr, size_t spillMaxSize = 32*1024);
+#else
+    SyslogHandler(bool color, const std::string& hostname, int port,
+        size_t backlogSize = 4096, const char* spillPath = nullptr, size_t spillMaxSize = 32*1024);
+    virtual ~SyslogHandler();
+
+    /**
+     * Configure the queue of datagrams waiting for the sender thread.
+     * @param maxPending  Maximum number of queued datagrams.
+     * @param block  If `true`, the caller waits for room in a full queue
+     *               instead of dropping the datagram.
+     */
+    void setSendQueue(size_t maxPending, bool block);
+
+    /**
+     * Number of datagrams dropped because the send queue was full.
      */
-    SyslogHandler(bool color, String hostname, int port);
+    unsigned long getDroppedCount() const { return _droppedCount.load(); }
+#endif
 
-    virtual void write(Logger::LogLevel level, const char *tag, const char* format, va_list ap);
+    virtual void writeRecord(const LogRecord& record);
+
+    /**
+     * Send the next batch of the backlog if connected and due.
+     */
+    void flushBacklog();
+
+    /**
+     * Set the pace for replaying the backlog.
+     */
+    void setReplayPacing(unsigned replayBatchSize, unsigned long replayIntervalMs)
+    {
+        _replayBatchSize = replayBatchSize;
+        _replayIntervalMs = replayIntervalMs;
+    }
 
 private:
+    bool isConnected();
+    void send(const LogRecord& record, time_t time);
+    void transmit(const char* msg, int msgLen);
+    void replay();
+    void sendNotice(const char* format, unsigned long count);
+
+#ifdef ARDUINO
     String _hostname;
     int _port;
     WiFiUDP _wifiUdp;
+#else
+#ifdef ESP_PLATFORM
+    static constexpr size_t _DEFAULT_MAX_PENDING = 32;
+#else
+    static constexpr size_t _DEFAULT_MAX_PENDING = 4096;
+#endif
+    struct Datagram
+    {
+        int len;
+        char data[LINE_BUFLEN];
+    };
+    void openSocket();
+    void senderLoop();
+    void sendBatch(const std::vector<Datagram>& batch);
+
+    std::string _hostname;
+    int _port;
+    int _socket;
+    unsigned long _lastOpenMs;
+    std::vector<Datagram> _pending;
+    std::vector<Datagram> _sending;
+    std::mutex _senderMutex;
+    std::condition_variable _senderCond;
+    std::condition_variable _spaceCond;
+    size_t _maxPending;
+    bool _blockWhenFull;
+    bool _stop;
+    std::atomic<unsigned long> _droppedCount;
+    unsigned long _unreportedDrops;
+    std::thread _sender;
+#endif
+    std::mutex _mutex;
+    LogBacklog _backlog;
+    BacklogEntry _entry;
+    unsigned _replayBatchSize;
+    unsigned long _replayIntervalMs;
+    unsigned long _lastReplayMs;
     static const int _LEVEL_MAPPING[];
     static constexpr int _FACILITY = 1;
 };
@@ -0,0 +1,575 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log_index.h"
+
+
+// ***************************************************************************
+
+MappedFile::~MappedFile()
+{
+    if (_data != nullptr && _size > 0)
+    {
+        munmap(const_cast<char*>(_data), _size);
+    }
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    _size = st.st_size;
+    _mtimeNs = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    if (_size > 0)
+    {
+        void* p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            _size = 0;
+            return false;
+        }
+        _data = static_cast<const char*>(p);
+    }
+    close(fd);
+    return true;
+}
+
+void MappedFile::advise(int advice) const
+{
+    if (_size > 0)
+    {
+        madvise(const_cast<char*>(_data), _size, advice);
+    }
+}
+
+// ***************************************************************************
+
+namespace {
+
+constexpr char MAGIC[8] = { 'L', '3', '2', 'I', 'D', 'X', '0', '1' };
+constexpr uint64_t BLOCK_ENTRIES = 1024;
+constexpr uint64_t BLOCK_WORDS = 3;  // minTime, maxTime, levelMask
+
+struct IndexHeader
+{
+    char magic[8];
+    uint64_t captureSize;
+    int64_t captureMtimeNs;
+    uint64_t entryCount;
+    uint64_t skippedLines;
+    uint64_t blockCount;
+    uint32_t deviceCount;
+    uint32_t tagCount;
+};
+
+/**
+ * Byte offsets of the sections following the header
+ */
+struct IndexLayout
+{
+    explicit IndexLayout(const IndexHeader& h)
+    {
+        entries = sizeof(IndexHeader);
+        blocks = entries + h.entryCount * sizeof(IndexEntry);
+        deviceOffsets = blocks + h.blockCount * BLOCK_WORDS * sizeof(uint64_t);
+        devicePostings = deviceOffsets + (h.deviceCount + 1) * sizeof(uint64_t);
+        tagOffsets = devicePostings + align8(h.entryCount * sizeof(uint32_t));
+        tagPostings = tagOffsets + (h.tagCount + 1) * sizeof(uint64_t);
+        strings = tagPostings + align8(h.entryCount * sizeof(uint32_t));
+    }
+    static uint64_t align8(uint64_t n) { return (n + 7) & ~(uint64_t) 7; }
+
+    uint64_t entries, blocks, deviceOffsets, devicePostings, tagOffsets, tagPostings, strings;
+};
+
+uint64_t levelBit(int level)
+{
+    return (uint64_t) 1 << std::min(level, 63);
+}
+
+/**
+ * Result of parsing one chunk of the capture
+ */
+struct Partial
+{
+    std::vector<IndexEntry> entries;
+    std::vector<std::string_view> devices;
+    std::vector<std::string_view> tags;
+    uint64_t skipped = 0;
+};
+
+uint32_t intern(std::unordered_map<std::string_view, uint32_t>& map,
+    std::vector<std::string_view>& names, std::string_view name)
+{
+    auto it = map.find(name);
+    if (it != map.end())
+    {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(names.size());
+    map.emplace(name, id);
+    names.push_back(name);
+    return id;
+}
+
+void parseChunk(const char* data, uint64_t begin, uint64_t end, Partial& partial)
+{
+    std::unordered_map<std::string_view, uint32_t> deviceIds, tagIds;
+    partial.entries.reserve((end - begin) / 64);
+    uint64_t pos = begin;
+    ParsedLine parsed;
+    while (pos < end)
+    {
+        const char* nl = static_cast<const char*>(memchr(data + pos, '\n', end - pos));
+        uint64_t lineEnd = nl == nullptr ? end : nl - data;
+        std::string_view line(data + pos, lineEnd - pos);
+        if (parseLine(line, parsed))
+        {
+            IndexEntry e;
+            e.offset = pos;
+            e.timeMs = parsed.timeMs;
+            e.length = static_cast<uint32_t>(line.size());
+            e.deviceId = intern(deviceIds, partial.devices, parsed.device);
+            e.tagId = intern(tagIds, partial.tags, parsed.tag);
+            e.level = static_cast<uint8_t>(std::min(std::max(parsed.level, 0), 255));
+            e.format = static_cast<uint8_t>(parsed.format);
+            e.reserved = 0;
+            partial.entries.push_back(e);
+        }
+        else if (!line.empty())
+        {
+            partial.skipped++;
+        }
+        pos = lineEnd + 1;
+    }
+}
+
+/**
+ * Counting sort of the entry indices by id into offsets/postings.
+ */
+void buildPostings(const std::vector<IndexEntry>& entries, size_t idCount,
+    uint32_t IndexEntry::* idField,
+    std::vector<uint64_t>& offsets, std::vector<uint32_t>& postings)
+{
+    offsets.assign(idCount + 1, 0);
+    for (const IndexEntry& e : entries)
+    {
+        offsets[e.*idField + 1]++;
+    }
+    for (size_t i = 1; i <= idCount; i++)
+    {
+        offsets[i] += offsets[i-1];
+    }
+    std::vector<uint64_t> fill(offsets.begin(), offsets.end() - 1);
+    postings.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        postings[fill[entries[i].*idField]++] = static_cast<uint32_t>(i);
+    }
+}
+
+/**
+ * Check the posting offsets of a loaded index against the id and entry counts.
+ */
+bool validOffsets(const uint64_t* offsets, uint32_t idCount, uint64_t entryCount)
+{
+    if (offsets[0] != 0 || offsets[idCount] != entryCount)
+    {
+        return false;
+    }
+    for (uint32_t id = 0; id < idCount; id++)
+    {
+        if (offsets[id] > offsets[id+1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void writeStrings(FILE* f, const std::vector<std::string>& strings)
+{
+    for (const std::string& s : strings)
+    {
+        uint32_t len = static_cast<uint32_t>(s.size());
+        fwrite(&len, sizeof(len), 1, f);
+        fwrite(s.data(), 1, len, f);
+    }
+}
+
+bool readStrings(const char*& p, const char* end, uint32_t count, std::vector<std::string>& strings)
+{
+    strings.clear();
+    strings.reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t len;
+        if (end - p < (std::ptrdiff_t) sizeof(len))
+        {
+            return false;
+        }
+        memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        if (end - p < (std::ptrdiff_t) len)
+        {
+            return false;
+        }
+        strings.emplace_back(p, len);
+        p += len;
+    }
+    return true;
+}
+
+void writePadding(FILE* f, uint64_t written)
+{
+    static const char ZEROS[8] = {};
+    fwrite(ZEROS, 1, IndexLayout::align8(written) - written, f);
+}
+
+}
+
+// ***************************************************************************
+
+void LogIndex::build(const MappedFile& capture, unsigned threads)
+{
+    const char* data = capture.data();
+    uint64_t size = capture.size();
+    _captureSize = size;
+    // the parser threads read their chunks front to back once
+    capture.advise(MADV_SEQUENTIAL);
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+    if (size < (uint64_t) threads * 1024 * 1024)
+    {
+        threads = static_cast<unsigned>(std::max<uint64_t>(1, size / (1024 * 1024)));
+    }
+
+    // split the capture into chunks at line boundaries
+    std::vector<uint64_t> bounds(threads + 1, size);
+    bounds[0] = 0;
+    for (unsigned i = 1; i < threads; i++)
+    {
+        uint64_t pos = std::max(bounds[i-1], size / threads * i);
+        const char* nl = pos < size ? static_cast<const char*>(memchr(data + pos, '\n', size - pos)) : nullptr;
+        bounds[i] = nl == nullptr ? size : (nl - data) + 1;
+    }
+
+    std::vector<Partial> partials(threads);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        workers.emplace_back(parseChunk, data, bounds[i], bounds[i+1], std::ref(partials[i]));
+    }
+    for (auto& it : workers)
+    {
+        it.join();
+    }
+    workers.clear();
+    // the query after the build reads the matching lines only
+    capture.advise(MADV_NORMAL);
+
+    // merge the dictionaries, then remap and concatenate in parallel
+    std::unordered_map<std::string_view, uint32_t> deviceIds, tagIds;
+    std::vector<std::string_view> deviceNames, tagNames;
+    std::vector<std::vector<uint32_t>> deviceMaps(threads), tagMaps(threads);
+    std::vector<uint64_t> starts(threads + 1, 0);
+    _skippedLines = 0;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        for (std::string_view name : partials[i].devices)
+        {
+            deviceMaps[i].push_back(intern(deviceIds, deviceNames, name));
+        }
+        for (std::string_view name : partials[i].tags)
+        {
+            tagMaps[i].push_back(intern(tagIds, tagNames, name));
+        }
+        starts[i+1] = starts[i] + partials[i].entries.size();
+        _skippedLines += partials[i].skipped;
+    }
+
+    _ownedEntries.resize(starts[threads]);
+    for (unsigned i = 0; i < threads; i++)
+    {
+        workers.emplace_back([&, i]() {
+            IndexEntry* out = &_ownedEntries[starts[i]];
+            for (const IndexEntry& e : partials[i].entries)
+            {
+                *out = e;
+                out->deviceId = deviceMaps[i][e.deviceId];
+                out->tagId = tagMaps[i][e.tagId];
+                out++;
+            }
+            std::vector<IndexEntry>().swap(partials[i].entries);
+        });
+    }
+    for (auto& it : workers)
+    {
+        it.join();
+    }
+
+    _devices.assign(deviceNames.begin(), deviceNames.end());
+    _tags.assign(tagNames.begin(), tagNames.end());
+    _entries = _ownedEntries.data();
+    _entryCount = _ownedEntries.size();
+
+    buildPostings(_ownedEntries, _devices.size(), &IndexEntry::deviceId, _ownedDeviceOffsets, _ownedDevicePostings);
+    buildPostings(_ownedEntries, _tags.size(), &IndexEntry::tagId, _ownedTagOffsets, _ownedTagPostings);
+    _deviceOffsets = _ownedDeviceOffsets.data();
+    _devicePostings = _ownedDevicePostings.data();
+    _tagOffsets = _ownedTagOffsets.data();
+    _tagPostings = _ownedTagPostings.data();
+
+    buildSummaries();
+}
+
+void LogIndex::buildSummaries()
+{
+    _blockCount = (_entryCount + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES;
+    _ownedBlocks.assign(_blockCount * BLOCK_WORDS, 0);
+    for (uint64_t b = 0; b < _blockCount; b++)
+    {
+        int64_t minTime = INT64_MAX, maxTime = INT64_MIN;
+        uint64_t levelMask = 0;
+        uint64_t end = std::min(_entryCount, (b + 1) * BLOCK_ENTRIES);
+        for (uint64_t i = b * BLOCK_ENTRIES; i < end; i++)
+        {
+            minTime = std::min(minTime, _entries[i].timeMs);
+            maxTime = std::max(maxTime, _entries[i].timeMs);
+            levelMask |= levelBit(_entries[i].level);
+        }
+        _ownedBlocks[b * BLOCK_WORDS + 0] = (uint64_t) minTime;
+        _ownedBlocks[b * BLOCK_WORDS + 1] = (uint64_t) maxTime;
+        _ownedBlocks[b * BLOCK_WORDS + 2] = levelMask;
+    }
+    _blocks = _ownedBlocks.data();
+}
+
+bool LogIndex::save(const std::string& path, const MappedFile& capture) const
+{
+    if (_entryCount > UINT32_MAX)
+    {
+        return false;  // postings hold 32 bit entry numbers
+    }
+    std::string tmpPath = path + ".tmp";
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if (f == nullptr)
+    {
+        return false;
+    }
+    IndexHeader h;
+    memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.captureSize = capture.size();
+    h.captureMtimeNs = capture.mtimeNs();
+    h.entryCount = _entryCount;
+    h.skippedLines = _skippedLines;
+    h.blockCount = _blockCount;
+    h.deviceCount = static_cast<uint32_t>(_devices.size());
+    h.tagCount = static_cast<uint32_t>(_tags.size());
+
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(_entries, sizeof(IndexEntry), _entryCount, f);
+    fwrite(_blocks, sizeof(uint64_t), _blockCount * BLOCK_WORDS, f);
+    fwrite(_deviceOffsets, sizeof(uint64_t), _devices.size() + 1, f);
+    fwrite(_devicePostings, sizeof(uint32_t), _entryCount, f);
+    writePadding(f, _entryCount * sizeof(uint32_t));
+    fwrite(_tagOffsets, sizeof(uint64_t), _tags.size() + 1, f);
+    fwrite(_tagPostings, sizeof(uint32_t), _entryCount, f);
+    writePadding(f, _entryCount * sizeof(uint32_t));
+    writeStrings(f, _devices);
+    writeStrings(f, _tags);
+
+    bool ok = !ferror(f);
+    ok = fclose(f) == 0 && ok;
+    return ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool LogIndex::load(const std::string& path, const MappedFile& capture)
+{
+    if (!_indexFile.open(path) || _indexFile.size() < sizeof(IndexHeader))
+    {
+        return false;
+    }
+    // queries touch few pages, no read-ahead of the whole index
+    _indexFile.advise(MADV_RANDOM);
+    IndexHeader h;
+    memcpy(&h, _indexFile.data(), sizeof(h));
+    if (memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0
+        || h.captureSize != capture.size() || h.captureMtimeNs != capture.mtimeNs())
+    {
+        return false;
+    }
+    // bound the counts first, so the layout cannot overflow
+    uint64_t fileSize = _indexFile.size();
+    if (h.entryCount > fileSize / sizeof(IndexEntry) || h.entryCount > UINT32_MAX
+        || h.blockCount != (h.entryCount + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES
+        || h.deviceCount > fileSize / sizeof(uint64_t) || h.tagCount > fileSize / sizeof(uint64_t))
+    {
+        return false;
+    }
+    IndexLayout layout(h);
+    if (layout.strings > fileSize)
+    {
+        return false;
+    }
+
+    const char* base = _indexFile.data();
+    const char* p = base + layout.strings;
+    const char* end = base + _indexFile.size();
+    if (!readStrings(p, end, h.deviceCount, _devices) || !readStrings(p, end, h.tagCount, _tags))
+    {
+        return false;
+    }
+    _entries = reinterpret_cast<const IndexEntry*>(base + layout.entries);
+    _entryCount = h.entryCount;
+    _skippedLines = h.skippedLines;
+    _blocks = reinterpret_cast<const uint64_t*>(base + layout.blocks);
+    _blockCount = h.blockCount;
+    _deviceOffsets = reinterpret_cast<const uint64_t*>(base + layout.deviceOffsets);
+    _devicePostings = reinterpret_cast<const uint32_t*>(base + layout.devicePostings);
+    _tagOffsets = reinterpret_cast<const uint64_t*>(base + layout.tagOffsets);
+    _tagPostings = reinterpret_cast<const uint32_t*>(base + layout.tagPostings);
+
+    _captureSize = capture.size();
+
+    // entries and postings are checked by query(), on the pages it touches anyway
+    return validOffsets(_deviceOffsets, h.deviceCount, _entryCount)
+        && validOffsets(_tagOffsets, h.tagCount, _entryCount);
+}
+
+bool LogIndex::matches(const IndexEntry& e, const LogQuery& q,
+    int64_t deviceId, int64_t tagId, const MappedFile& capture) const
+{
+    if (e.level < q.minLevel || e.level > q.maxLevel || e.timeMs < q.fromMs || e.timeMs > q.toMs)
+    {
+        return false;
+    }
+    if ((deviceId >= 0 && e.deviceId != deviceId) || (tagId >= 0 && e.tagId != tagId))
+    {
+        return false;
+    }
+    if (!q.contains.empty())
+    {
+        return memmem(capture.data() + e.offset, e.length, q.contains.data(), q.contains.size()) != nullptr;
+    }
+    return true;
+}
+
+bool LogIndex::query(const LogQuery& q, const MappedFile& capture,
+    const std::function<void(const IndexEntry&)>& fn) const
+{
+    auto findId = [](const std::vector<std::string>& names, const std::string& name) -> int64_t {
+        auto it = std::find(names.begin(), names.end(), name);
+        return it == names.end() ? -1 : it - names.begin();
+    };
+
+    // with a device or tag filter, walk the shorter posting list
+    const uint32_t* postings = nullptr;
+    uint64_t postingsCount = 0;
+    int64_t deviceId = -1, tagId = -1;
+    if (q.hasDevice)
+    {
+        deviceId = findId(_devices, q.device);
+        if (deviceId < 0)
+        {
+            return true;
+        }
+        postings = _devicePostings + _deviceOffsets[deviceId];
+        postingsCount = _deviceOffsets[deviceId+1] - _deviceOffsets[deviceId];
+    }
+    if (q.hasTag)
+    {
+        tagId = findId(_tags, q.tag);
+        if (tagId < 0)
+        {
+            return true;
+        }
+        uint64_t count = _tagOffsets[tagId+1] - _tagOffsets[tagId];
+        if (postings == nullptr || count < postingsCount)
+        {
+            postings = _tagPostings + _tagOffsets[tagId];
+            postingsCount = count;
+        }
+    }
+
+    // a damaged index must not send the query out of bounds, only the
+    // postings and entries visited are checked
+    bool consistent = true;
+    auto visit = [&](const IndexEntry& e) {
+        if (!validEntry(e))
+        {
+            consistent = false;
+        }
+        else if (matches(e, q, deviceId, tagId, capture))
+        {
+            fn(e);
+        }
+    };
+
+    if (postings != nullptr)
+    {
+        for (uint64_t i = 0; i < postingsCount; i++)
+        {
+            if (postings[i] >= _entryCount)
+            {
+                consistent = false;
+                continue;
+            }
+            visit(_entries[postings[i]]);
+        }
+        return consistent;
+    }
+
+    // otherwise skip blocks by their time range and levels
+    uint64_t levelMask = 0;
+    for (int level = std::max(q.minLevel, 0); level <= std::min(q.maxLevel, 63); level++)
+    {
+        levelMask |= levelBit(level);
+    }
+    if (q.maxLevel > 63)
+    {
+        levelMask |= levelBit(63);
+    }
+    for (uint64_t b = 0; b < _blockCount; b++)
+    {
+        const uint64_t* block = &_blocks[b * BLOCK_WORDS];
+        if ((int64_t) block[0] > q.toMs || (int64_t) block[1] < q.fromMs || (block[2] & levelMask) == 0)
+        {
+            continue;
+        }
+        uint64_t end = std::min(_entryCount, (b + 1) * BLOCK_ENTRIES);
+        for (uint64_t i = b * BLOCK_ENTRIES; i < end; i++)
+        {
+            visit(_entries[i]);
+        }
+    }
+    return consistent;
+}
+
+// ***************************************************************************
@@ -0,0 +1,162 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "log_parser.h"
+
+
+// ***************************************************************************
+
+/**
+ * Read-only memory mapping of a file
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * Map the file, return `false` on error (see errno).
+     */
+    bool open(const std::string& path);
+
+    /**
+     * Pass an access pattern hint (MADV_...) for the whole mapping.
+     */
+    void advise(int advice) const;
+
+    const char* data() const { return _data; }
+    uint64_t size() const { return _size; }
+    int64_t mtimeNs() const { return _mtimeNs; }
+
+private:
+    const char* _data = nullptr;
+    uint64_t _size = 0;
+    int64_t _mtimeNs = 0;
+};
+
+// ***************************************************************************
+
+/**
+ * Index entry for one log line of the capture (32 bytes)
+ */
+struct IndexEntry
+{
+    uint64_t offset;     ///< start of the line in the capture
+    int64_t timeMs;      ///< see ParsedLine::timeMs
+    uint32_t length;     ///< length of the line without line terminator
+    uint32_t deviceId;   ///< index into LogIndex::devices()
+    uint32_t tagId;      ///< index into LogIndex::tags()
+    uint8_t level;
+    uint8_t format;      ///< LineFormat
+    uint16_t reserved;
+};
+
+/**
+ * Filter for LogIndex::query(), unset fields match everything
+ */
+struct LogQuery
+{
+    int minLevel = 0;
+    int maxLevel = 255;
+    int64_t fromMs = INT64_MIN;
+    int64_t toMs = INT64_MAX;
+    bool hasDevice = false;
+    std::string device;
+    bool hasTag = false;
+    std::string tag;
+    std::string contains;  ///< substring of the line, checked on the capture
+};
+
+/**
+ * On-disk index of a capture by time, device, tag and level
+ *
+ * The index holds one IndexEntry per recognized line, summaries of
+ * blocks of entries (time range and levels) and posting lists
+ * per device and per tag. Queries only touch the index and the
+ * matching lines of the capture.
+ */
+class LogIndex
+{
+public:
+    /**
+     * Parse the capture in parallel and build the index in memory.
+     */
+    void build(const MappedFile& capture, unsigned threads);
+
+    /**
+     * Write the index to path, tagged with size and mtime of the capture.
+     */
+    bool save(const std::string& path, const MappedFile& capture) const;
+
+    /**
+     * Load an index from path, fails if it does not match the capture.
+     *
+     * Only the header, the posting offsets and the names are checked,
+     * so loading does not touch every entry. Entries and postings are
+     * checked when a query visits them.
+     */
+    bool load(const std::string& path, const MappedFile& capture);
+
+    /**
+     * Call fn for each entry matching the query, in capture order.
+     * @return `false` if damaged entries or postings were skipped, i.e.
+     *         the index should be rebuilt.
+     */
+    bool query(const LogQuery& q, const MappedFile& capture,
+        const std::function<void(const IndexEntry&)>& fn) const;
+
+    /**
+     * `true` if the ids and the line range of the entry are in bounds.
+     */
+    bool validEntry(const IndexEntry& e) const
+    {
+        return e.deviceId < _devices.size() && e.tagId < _tags.size()
+            && e.offset <= _captureSize && e.length <= _captureSize - e.offset;
+    }
+
+    uint64_t entryCount() const { return _entryCount; }
+    uint64_t skippedLines() const { return _skippedLines; }
+    const std::vector<std::string>& devices() const { return _devices; }
+    const std::vector<std::string>& tags() const { return _tags; }
+    const IndexEntry& entry(uint64_t i) const { return _entries[i]; }
+
+private:
+    bool matches(const IndexEntry& e, const LogQuery& q,
+        int64_t deviceId, int64_t tagId, const MappedFile& capture) const;
+    void buildSummaries();
+
+    // either owned (after build) or pointing into the mapped index (after load)
+    std::vector<IndexEntry> _ownedEntries;
+    std::vector<uint64_t> _ownedBlocks;
+    std::vector<uint64_t> _ownedDeviceOffsets, _ownedTagOffsets;
+    std::vector<uint32_t> _ownedDevicePostings, _ownedTagPostings;
+    MappedFile _indexFile;
+
+    const IndexEntry* _entries = nullptr;
+    uint64_t _entryCount = 0;
+    uint64_t _skippedLines = 0;
+    uint64_t _captureSize = 0;
+    const uint64_t* _blocks = nullptr;  ///< per block: minTime, maxTime, levelMask
+    uint64_t _blockCount = 0;
+    const uint64_t* _deviceOffsets = nullptr;
+    const uint32_t* _devicePostings = nullptr;
+    const uint64_t* _tagOffsets = nullptr;
+    const uint32_t* _tagPostings = nullptr;
+    std::vector<std::string> _devices;
+    std::vector<std::string> _tags;
+};
+
+// ***************************************************************************
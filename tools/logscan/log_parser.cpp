@@ -0,0 +1,291 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#include <cstring>
+#include <strings.h>
+
+#include "log_parser.h"
+
+
+// ***************************************************************************
+
+namespace {
+
+// logger32 levels for the syslog severities 0..7
+const int SYSLOG_LEVEL_MAPPING[] =
+{
+    /*0:emergency*/50, /*1:alert*/50, /*2:critical*/50, /*3:error*/40,
+    /*4:warning*/  30, /*5:notice*/20, /*6:info*/   20, /*7:debug*/10,
+};
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Longest digit run accepted by parseNumber(), seconds of this size
+ * still fit into int64_t after scaling to milliseconds.
+ */
+const size_t MAX_NUMBER_DIGITS = 15;
+
+/**
+ * Parse an unsigned decimal number at pos, advancing pos.
+ * Fails on more than MAX_NUMBER_DIGITS digits, so value cannot overflow.
+ */
+bool parseNumber(std::string_view s, size_t& pos, int64_t& value)
+{
+    size_t start = pos;
+    value = 0;
+    while (pos < s.size() && isDigit(s[pos]))
+    {
+        if (pos - start == MAX_NUMBER_DIGITS)
+        {
+            return false;
+        }
+        value = value * 10 + (s[pos] - '0');
+        pos++;
+    }
+    return pos > start;
+}
+
+/**
+ * Skip ANSI color sequences like `ESC[36m` at pos.
+ */
+void skipColor(std::string_view s, size_t& pos)
+{
+    while (pos + 1 < s.size() && s[pos] == '\x1b' && s[pos+1] == '[')
+    {
+        size_t end = s.find('m', pos + 2);
+        if (end == std::string_view::npos)
+        {
+            return;
+        }
+        pos = end + 1;
+    }
+}
+
+/**
+ * Remove a trailing ANSI color sequence.
+ */
+std::string_view stripTrailingColor(std::string_view s)
+{
+    if (!s.empty() && s.back() == 'm')
+    {
+        size_t esc = s.rfind('\x1b');
+        if (esc != std::string_view::npos && esc + 1 < s.size() && s[esc+1] == '[')
+        {
+            return s.substr(0, esc);
+        }
+    }
+    return s;
+}
+
+/**
+ * Extract the field up to the next separator, advancing pos behind it.
+ */
+bool nextField(std::string_view s, size_t& pos, char separator, std::string_view& field)
+{
+    size_t end = s.find(separator, pos);
+    if (end == std::string_view::npos)
+    {
+        return false;
+    }
+    field = s.substr(pos, end - pos);
+    pos = end + 1;
+    return true;
+}
+
+/**
+ * Days since 1970-01-01 for a date in the proleptic Gregorian calendar.
+ */
+int64_t daysFromCivil(int64_t y, int64_t m, int64_t d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+bool parseSerialLine(std::string_view s, size_t pos, ParsedLine& parsed)
+{
+    int64_t sec, msec, level;
+    size_t msStart;
+    if (!parseNumber(s, pos, sec) || pos >= s.size() || s[pos] != '.')
+    {
+        return false;
+    }
+    pos++;
+    msStart = pos;
+    if (!parseNumber(s, pos, msec) || pos - msStart != 3 || pos >= s.size() || s[pos] != ':')
+    {
+        return false;
+    }
+    pos++;
+    if (!parseNumber(s, pos, level) || pos >= s.size() || s[pos] != ':')
+    {
+        return false;
+    }
+    pos++;
+    if (!nextField(s, pos, ':', parsed.device) || !nextField(s, pos, ':', parsed.tag))
+    {
+        return false;
+    }
+    parsed.format = LineFormat::SERIAL;
+    parsed.level = static_cast<int>(level);
+    parsed.timeMs = sec * 1000 + msec;
+    parsed.task = std::string_view();
+    parsed.message = stripTrailingColor(s.substr(pos));
+    return true;
+}
+
+bool parseSyslogLine(std::string_view s, size_t pos, ParsedLine& parsed)
+{
+    int64_t pri;
+    pos++; // '<'
+    if (!parseNumber(s, pos, pri) || pos + 2 >= s.size() || s[pos] != '>' || s[pos+1] != '1' || s[pos+2] != ' ')
+    {
+        return false;
+    }
+    pos += 3;
+
+    std::string_view timestamp, uptime;
+    if (!nextField(s, pos, ' ', timestamp) || !nextField(s, pos, ' ', parsed.device)
+        || !nextField(s, pos, ' ', parsed.tag) || !nextField(s, pos, ' ', parsed.task))
+    {
+        return false;
+    }
+    if (!nextField(s, pos, ' ', uptime))
+    {
+        uptime = s.substr(pos);
+        pos = s.size();
+    }
+
+    if (!parseTimestamp(timestamp, parsed.timeMs))
+    {
+        // no wall clock time, fall back to the uptime in MSGID (sec.ms)
+        size_t upos = 0;
+        int64_t sec = 0, msec = 0;
+        if (!parseNumber(uptime, upos, sec) && upos < uptime.size() && isDigit(uptime[upos]))
+        {
+            return false;
+        }
+        if (upos < uptime.size() && uptime[upos] == '.')
+        {
+            upos++;
+            if (!parseNumber(uptime, upos, msec) && upos < uptime.size() && isDigit(uptime[upos]))
+            {
+                return false;
+            }
+        }
+        parsed.timeMs = sec * 1000 + msec;
+    }
+
+    auto nil = [](std::string_view v) { return v == "-" ? std::string_view() : v; };
+    parsed.format = LineFormat::SYSLOG;
+    parsed.level = SYSLOG_LEVEL_MAPPING[pri & 7];
+    parsed.device = nil(parsed.device);
+    parsed.tag = nil(parsed.tag);
+    parsed.task = nil(parsed.task);
+    size_t msgPos = pos;
+    skipColor(s, msgPos);
+    parsed.message = stripTrailingColor(s.substr(msgPos));
+    return true;
+}
+
+}
+
+// ***************************************************************************
+
+bool parseTimestamp(std::string_view s, int64_t& timeMs)
+{
+    if (s.size() < 20 || s[4] != '-' || s[7] != '-' || s[10] != 'T' || s[13] != ':' || s[16] != ':')
+    {
+        return false;
+    }
+    const size_t DIGITS[] = { 0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, 17, 18 };
+    for (size_t i : DIGITS)
+    {
+        if (!isDigit(s[i]))
+        {
+            return false;
+        }
+    }
+    auto num = [s](size_t pos, size_t len) {
+        int64_t v = 0;
+        for (size_t i = pos; i < pos + len; i++)
+        {
+            v = v * 10 + (s[i] - '0');
+        }
+        return v;
+    };
+    int64_t days = daysFromCivil(num(0, 4), num(5, 2), num(8, 2));
+    int64_t seconds = days * 86400 + num(11, 2) * 3600 + num(14, 2) * 60 + num(17, 2);
+    int64_t ms = 0;
+    size_t pos = 19;
+    if (s[pos] == '.')
+    {
+        pos++;
+        int64_t scale = 100;
+        while (pos < s.size() && isDigit(s[pos]))
+        {
+            ms += (s[pos] - '0') * scale;
+            scale /= 10;
+            pos++;
+        }
+    }
+    timeMs = seconds * 1000 + ms;
+    return true;
+}
+
+bool parseLine(std::string_view line, ParsedLine& parsed)
+{
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.remove_suffix(1);
+    }
+    size_t pos = 0;
+    while (pos < line.size() && line[pos] == ' ')
+    {
+        pos++;
+    }
+    if (pos < line.size() && line[pos] == '<')
+    {
+        return parseSyslogLine(line, pos, parsed);
+    }
+    skipColor(line, pos);
+    if (pos < line.size() && isDigit(line[pos]))
+    {
+        return parseSerialLine(line, pos, parsed);
+    }
+    return false;
+}
+
+int parseLevel(std::string_view str)
+{
+    static const struct { const char* name; int level; } NAMES[] =
+    {
+        { "CRITICAL", 50 }, { "ERROR", 40 }, { "WARNING", 30 }, { "WARN", 30 },
+        { "INFO", 20 }, { "DEBUG", 10 }, { "NOTSET", 0 },
+    };
+    for (auto& it : NAMES)
+    {
+        if (str.size() == strlen(it.name) && strncasecmp(str.data(), it.name, str.size()) == 0)
+        {
+            return it.level;
+        }
+    }
+    size_t pos = 0;
+    int64_t value;
+    if (parseNumber(str, pos, value) && pos == str.size() && value <= 255)
+    {
+        return static_cast<int>(value);
+    }
+    return -1;
+}
+
+// ***************************************************************************
@@ -0,0 +1,60 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+
+// ***************************************************************************
+
+/**
+ * Line formats understood by the parser
+ */
+enum class LineFormat : uint8_t { UNKNOWN = 0, SERIAL = 1, SYSLOG = 2 };
+
+/**
+ * Fields of one parsed log line
+ *
+ * The string views point into the parsed input. timeMs is the uptime in
+ * milliseconds for the SerialLogHandler format and the UTC time in
+ * milliseconds since the epoch for the SyslogHandler format.
+ */
+struct ParsedLine
+{
+    LineFormat format;
+    int level;
+    int64_t timeMs;
+    std::string_view device;
+    std::string_view tag;
+    std::string_view task;
+    std::string_view message;
+};
+
+/**
+ * Parse one line (without line terminator) written by logger32.
+ *
+ * Recognized formats:
+ * - SerialLogHandler: `[color]sec.ms:level:device:tag:message[color]`
+ * - SyslogHandler (RFC 5424): `<pri>1 timestamp device tag task sec.ms message`
+ *
+ * @return `false` if the line is in neither of the formats.
+ */
+bool parseLine(std::string_view line, ParsedLine& parsed);
+
+/**
+ * Parse an RFC 3339 UTC timestamp as written by the SyslogHandler
+ * (e.g. "2022-01-04T11:30:00Z", optionally with fractional seconds).
+ */
+bool parseTimestamp(std::string_view s, int64_t& timeMs);
+
+/**
+ * Parse a log level given by name (e.g. "WARNING") or number (e.g. "30").
+ * @return the level or -1 if invalid
+ */
+int parseLevel(std::string_view str);
+
+// ***************************************************************************
@@ -0,0 +1,265 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ *
+ * logscan: index and query captured logger32 output on a host.
+ */
+
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "log_index.h"
+
+
+// ***************************************************************************
+
+namespace {
+
+const char* USAGE =
+    "Usage: logscan [options] CAPTURE\n"
+    "\n"
+    "Index and filter logger32 output (SerialLogHandler and SyslogHandler lines).\n"
+    "The index is stored as CAPTURE.l32idx and rebuilt when the capture changes.\n"
+    "\n"
+    "Filters:\n"
+    "  --level L         only messages with level L (name or number)\n"
+    "  --min-level L     only messages with level L or above\n"
+    "  --device D        only messages from device D\n"
+    "  --tag T           only messages with tag T\n"
+    "  --from TIME       only messages at or after TIME\n"
+    "  --to TIME         only messages at or before TIME\n"
+    "                    TIME is milliseconds (uptime for serial captures)\n"
+    "                    or an UTC timestamp like 2022-01-04T11:30:00Z\n"
+    "  --grep S          only lines containing S\n"
+    "Output:\n"
+    "  --count           print the number of matching lines only\n"
+    "  --stats           print the devices, tags and levels in the capture\n"
+    "  --index-only      build the index and exit\n"
+    "Options:\n"
+    "  --threads N       number of parser threads (default: all cores)\n"
+    "  --rebuild         rebuild the index even if it is up to date\n"
+    "  --verbose         print timing information to stderr\n";
+
+bool parseTime(const char* str, int64_t& timeMs)
+{
+    if (parseTimestamp(str, timeMs))
+    {
+        return true;
+    }
+    char* end;
+    errno = 0;
+    timeMs = strtoll(str, &end, 10);
+    return errno == 0 && *end == '\0' && end != str;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printStats(const LogIndex& index)
+{
+    std::vector<uint64_t> deviceCounts(index.devices().size()), tagCounts(index.tags().size());
+    uint64_t levelCounts[256] = {};
+    for (uint64_t i = 0; i < index.entryCount(); i++)
+    {
+        const IndexEntry& e = index.entry(i);
+        if (!index.validEntry(e))
+        {
+            continue;
+        }
+        deviceCounts[e.deviceId]++;
+        tagCounts[e.tagId]++;
+        levelCounts[e.level]++;
+    }
+    printf("lines: %llu indexed, %llu not recognized\n",
+        (unsigned long long) index.entryCount(), (unsigned long long) index.skippedLines());
+    printf("levels:\n");
+    for (int level = 0; level < 256; level++)
+    {
+        if (levelCounts[level] > 0)
+        {
+            printf("  %3d %12llu\n", level, (unsigned long long) levelCounts[level]);
+        }
+    }
+    printf("devices:\n");
+    for (size_t i = 0; i < deviceCounts.size(); i++)
+    {
+        printf("  %-24s %12llu\n", index.devices()[i].c_str(), (unsigned long long) deviceCounts[i]);
+    }
+    printf("tags:\n");
+    for (size_t i = 0; i < tagCounts.size(); i++)
+    {
+        printf("  %-24s %12llu\n", index.tags()[i].c_str(), (unsigned long long) tagCounts[i]);
+    }
+}
+
+}
+
+// ***************************************************************************
+
+int main(int argc, char* argv[])
+{
+    LogQuery query;
+    unsigned threads = std::thread::hardware_concurrency();
+    bool count = false, stats = false, indexOnly = false, rebuild = false, verbose = false;
+    const char* capturePath = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--level" || arg == "--min-level") && hasValue)
+        {
+            int level = parseLevel(argv[++i]);
+            if (level < 0)
+            {
+                fprintf(stderr, "logscan: invalid level '%s'\n", argv[i]);
+                return 2;
+            }
+            query.minLevel = level;
+            if (arg == "--level")
+            {
+                query.maxLevel = level;
+            }
+        }
+        else if (arg == "--device" && hasValue)
+        {
+            query.hasDevice = true;
+            query.device = argv[++i];
+        }
+        else if (arg == "--tag" && hasValue)
+        {
+            query.hasTag = true;
+            query.tag = argv[++i];
+        }
+        else if ((arg == "--from" || arg == "--to") && hasValue)
+        {
+            if (!parseTime(argv[++i], arg == "--from" ? query.fromMs : query.toMs))
+            {
+                fprintf(stderr, "logscan: invalid time '%s'\n", argv[i]);
+                return 2;
+            }
+        }
+        else if (arg == "--grep" && hasValue)
+        {
+            query.contains = argv[++i];
+        }
+        else if (arg == "--threads" && hasValue)
+        {
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        }
+        else if (arg == "--count")
+        {
+            count = true;
+        }
+        else if (arg == "--stats")
+        {
+            stats = true;
+        }
+        else if (arg == "--index-only")
+        {
+            indexOnly = true;
+        }
+        else if (arg == "--rebuild")
+        {
+            rebuild = true;
+        }
+        else if (arg == "--verbose")
+        {
+            verbose = true;
+        }
+        else if (arg[0] != '-' && capturePath == nullptr)
+        {
+            capturePath = argv[i];
+        }
+        else
+        {
+            fputs(USAGE, stderr);
+            return 2;
+        }
+    }
+    if (capturePath == nullptr)
+    {
+        fputs(USAGE, stderr);
+        return 2;
+    }
+
+    MappedFile capture;
+    if (!capture.open(capturePath))
+    {
+        fprintf(stderr, "logscan: cannot open %s: %s\n", capturePath, strerror(errno));
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string indexPath = std::string(capturePath) + ".l32idx";
+    LogIndex index;
+    if (rebuild || !index.load(indexPath, capture))
+    {
+        index.build(capture, threads);
+        double seconds = secondsSince(start);
+        if (verbose)
+        {
+            fprintf(stderr, "logscan: parsed %llu lines in %.3f s (%.1f MB/s)\n",
+                (unsigned long long) index.entryCount(), seconds, capture.size() / seconds / 1e6);
+        }
+        if (!index.save(indexPath, capture))
+        {
+            fprintf(stderr, "logscan: cannot write index %s\n", indexPath.c_str());
+        }
+    }
+    else if (verbose)
+    {
+        fprintf(stderr, "logscan: loaded index with %llu lines in %.3f s\n",
+            (unsigned long long) index.entryCount(), secondsSince(start));
+    }
+
+    if (indexOnly)
+    {
+        return 0;
+    }
+    if (stats)
+    {
+        printStats(index);
+        return 0;
+    }
+
+    start = std::chrono::steady_clock::now();
+    uint64_t matches = 0;
+    static char outBuffer[1 << 20];
+    setvbuf(stdout, outBuffer, _IOFBF, sizeof(outBuffer));
+    bool consistent = index.query(query, capture, [&](const IndexEntry& e) {
+        matches++;
+        if (!count)
+        {
+            fwrite(capture.data() + e.offset, 1, e.length, stdout);
+            fputc('\n', stdout);
+        }
+    });
+    if (!consistent)
+    {
+        // damaged entries were skipped, the next run starts from a fresh index
+        fprintf(stderr, "logscan: index %s is damaged, results may be incomplete; removed\n", indexPath.c_str());
+        remove(indexPath.c_str());
+    }
+    if (count)
+    {
+        printf("%llu\n", (unsigned long long) matches);
+    }
+    fflush(stdout);
+    if (verbose)
+    {
+        fprintf(stderr, "logscan: %llu matching lines in %.3f s\n",
+            (unsigned long long) matches, secondsSince(start));
+    }
+    return consistent ? 0 : 1;
+}
+
+// ***************************************************************************
@@ -0,0 +1,320 @@
+/**
+ * Logger for 32 Bit Microcontrollers
+ * Copyright (c) 2021 clausgf@github. See LICENSE.md for legal information.
+ *
+ * logscan_check: parse lines rendered by the logger32 layouts and
+ * query a saved index.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <logger.h>
+#include <syslog_handler.h>
+
+#include "log_index.h"
+
+
+Logger rootLogger = Logger( /*tag*/"main", nullptr );
+
+static std::string directory;
+static int failCount = 0;
+
+
+// ***************************************************************************
+//             HELPERS
+// ***************************************************************************
+
+static void expect(bool condition, const char* what)
+{
+    printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+    if (!condition)
+    {
+        failCount++;
+    }
+}
+
+static bool equals(std::string_view view, const char* str)
+{
+    return view == std::string_view(str == nullptr ? "" : str);
+}
+
+/**
+ * Log handler rendering records with a layout, like the handlers
+ * writing to the serial port or to a syslog server.
+ */
+class RenderingLogHandler: public LogHandler
+{
+public:
+    RenderingLogHandler(bool color, const char* layout): LogHandler(color, layout)
+    {
+        setDeviceId("e32-a1b2c3");
+    }
+
+    std::string render(const LogRecord& record, time_t wallTime = 0)
+    {
+        // severity as sent by SyslogHandler with facility 1
+        static const int SEVERITIES[] = { 7, 7, 6, 4, 3, 2 };
+        char line[LINE_BUFLEN];
+        int len = formatLine(line, sizeof(line), record, wallTime, 8 + SEVERITIES[(int) record.level / 10]);
+        return std::string(line, len);
+    }
+};
+
+struct Sample
+{
+    Logger::LogLevel level;
+    const char* tag;
+    const char* task;
+    unsigned long ms;
+    const char* message;
+};
+
+const Sample SAMPLES[] =
+{
+    { Logger::LogLevel::DEBUG, "main", "loopTask", 0, "started" },
+    { Logger::LogLevel::INFO, "wifi", nullptr, 12345, "connected to ap:1 (rssi -60)" },
+    { Logger::LogLevel::WARNING, "", "async_tcp", 86400999, "retry 3 of 5" },
+    { Logger::LogLevel::ERROR, "ota", "", 4294967295UL, "" },
+    { Logger::LogLevel::CRITICAL, "power", "main", 61001, "brownout" },
+};
+
+static LogRecord recordOf(const Sample& sample)
+{
+    LogRecord record;
+    record.level = sample.level;
+    record.tag = sample.tag;
+    record.task = sample.task;
+    record.ms = sample.ms;
+    record.time = 0;
+    record.message = sample.message;
+    return record;
+}
+
+/**
+ * Level as seen through the syslog severity.
+ */
+static int syslogLevelOf(Logger::LogLevel level)
+{
+    return level == Logger::LogLevel::CRITICAL ? 50 : (int) level;
+}
+
+
+// ***************************************************************************
+//             CHECKS
+// ***************************************************************************
+
+/**
+ * Lines of the default serial layout, with and without color and with
+ * CR line endings.
+ */
+static void checkSerialLayout(bool color, const char* lineEnd, const char* what)
+{
+    RenderingLogHandler handler(color, LogHandler::DEFAULT_LAYOUT);
+    bool ok = true;
+    for (const Sample& sample : SAMPLES)
+    {
+        std::string line = handler.render(recordOf(sample)) + lineEnd;
+        ParsedLine parsed;
+        ok = ok && parseLine(line, parsed)
+            && parsed.format == LineFormat::SERIAL
+            && parsed.level == (int) sample.level
+            && parsed.timeMs == (int64_t) sample.ms
+            && equals(parsed.device, "e32-a1b2c3")
+            && equals(parsed.tag, sample.tag)
+            && equals(parsed.message, sample.message);
+        if (!ok)
+        {
+            printf("      not parsed back: %s\n", line.c_str());
+            break;
+        }
+    }
+    expect(ok, what);
+}
+
+/**
+ * Lines of the default syslog layout, with NILVALUE for empty fields.
+ */
+static void checkSyslogLayout(bool color, const char* lineEnd, const char* what)
+{
+    RenderingLogHandler handler(color, SyslogHandler::DEFAULT_SYSLOG_LAYOUT);
+    const time_t wallTime = 1641295800;  // 2022-01-04T11:30:00Z
+    bool ok = true;
+    for (const Sample& sample : SAMPLES)
+    {
+        std::string line = handler.render(recordOf(sample), wallTime) + lineEnd;
+        ParsedLine parsed;
+        ok = ok && parseLine(line, parsed)
+            && parsed.format == LineFormat::SYSLOG
+            && parsed.level == syslogLevelOf(sample.level)
+            && parsed.timeMs == (int64_t) wallTime * 1000
+            && equals(parsed.device, "e32-a1b2c3")
+            && equals(parsed.tag, sample.tag)
+            && equals(parsed.task, sample.task)
+            && equals(parsed.message, sample.message);
+        if (!ok)
+        {
+            printf("      not parsed back: %s\n", line.c_str());
+            break;
+        }
+    }
+    expect(ok, what);
+}
+
+/**
+ * Without wall clock time, the syslog line is timed by its uptime.
+ */
+static void checkSyslogUptime()
+{
+    RenderingLogHandler handler(false, "<%P>1 - %-d %-t %-k %U %m");
+    std::string line = handler.render(recordOf(SAMPLES[1]));
+    ParsedLine parsed;
+    expect(parseLine(line, parsed) && parsed.timeMs == 12345, "syslog line without timestamp: uptime used");
+}
+
+static void checkRejected()
+{
+    const char* LINES[] =
+    {
+        "",
+        "hello world",
+        "12.34:20:dev:tag:message",
+        "12.345:20:dev",
+        "1234567890123456789012.345:20:dev:tag:message",
+        "<14>1 2022-01-04T11:30:00Z dev",
+        "<14>1 - dev tag task 99999999999999999999999.000 message",
+    };
+    bool ok = true;
+    for (const char* line : LINES)
+    {
+        ParsedLine parsed;
+        if (parseLine(line, parsed))
+        {
+            printf("      accepted: %s\n", line);
+            ok = false;
+        }
+    }
+    expect(ok, "malformed lines and overlong numbers rejected");
+}
+
+/**
+ * Save an index, load it again and compare queries with a scan of the lines.
+ */
+static void checkIndex()
+{
+    std::string capturePath = directory + "/capture.log";
+    std::string indexPath = capturePath + ".l32idx";
+    RenderingLogHandler serial(true, LogHandler::DEFAULT_LAYOUT);
+    const int LINES = 5000;
+    std::vector<Sample> samples;
+    FILE* f = fopen(capturePath.c_str(), "wb");
+    for (int i = 0; i < LINES; i++)
+    {
+        Sample sample = SAMPLES[i % 5];
+        sample.ms = i * 10;
+        samples.push_back(sample);
+        fputs((serial.render(recordOf(sample)) + "\n").c_str(), f);
+        if (i % 100 == 0)
+        {
+            fputs("garbage\n", f);
+        }
+    }
+    fclose(f);
+
+    MappedFile capture;
+    expect(capture.open(capturePath), "capture mapped");
+    {
+        LogIndex index;
+        index.build(capture, 2);
+        expect(index.entryCount() == LINES && index.skippedLines() == LINES / 100, "index build: every line indexed, others skipped");
+        expect(index.save(indexPath, capture), "index saved");
+    }
+
+    LogIndex index;
+    expect(index.load(indexPath, capture), "index loaded");
+    struct Case
+    {
+        const char* what;
+        LogQuery query;
+        bool (*match)(const Sample& sample);
+    };
+    std::vector<Case> cases(4);
+    cases[0].what = "query by tag";
+    cases[0].query.hasTag = true;
+    cases[0].query.tag = "wifi";
+    cases[0].match = [](const Sample& s) { return strcmp(s.tag, "wifi") == 0; };
+    cases[1].what = "query by device and minimum level";
+    cases[1].query.hasDevice = true;
+    cases[1].query.device = "e32-a1b2c3";
+    cases[1].query.minLevel = 40;
+    cases[1].match = [](const Sample& s) { return (int) s.level >= 40; };
+    cases[2].what = "query by time range";
+    cases[2].query.fromMs = 10000;
+    cases[2].query.toMs = 20000;
+    cases[2].match = [](const Sample& s) { return s.ms >= 10000 && s.ms <= 20000; };
+    cases[3].what = "query by substring";
+    cases[3].query.contains = "brown";
+    cases[3].match = [](const Sample& s) { return strstr(s.message, "brown") != nullptr; };
+    for (const Case& c : cases)
+    {
+        std::vector<unsigned long> found, expected;
+        bool consistent = index.query(c.query, capture, [&](const IndexEntry& e) {
+            found.push_back((unsigned long) e.timeMs);
+        });
+        for (const Sample& sample : samples)
+        {
+            if (c.match(sample))
+            {
+                expected.push_back(sample.ms);
+            }
+        }
+        expect(consistent && !found.empty() && found == expected, c.what);
+    }
+
+    // a damaged entry is skipped by the query and reported (the header has 56 bytes)
+    f = fopen(indexPath.c_str(), "r+b");
+    fseek(f, 56 + 3 * sizeof(IndexEntry) + offsetof(IndexEntry, deviceId), SEEK_SET);
+    fwrite("\xff\xff\xff\xff", 1, 4, f);
+    fclose(f);
+    LogIndex damaged;
+    uint64_t count = 0;
+    bool consistent = damaged.load(indexPath, capture)
+        && damaged.query(LogQuery(), capture, [&](const IndexEntry&) { count++; });
+    expect(!consistent && count == LINES - 1, "damaged index entry skipped and reported");
+}
+
+
+// ***************************************************************************
+//             MAIN
+// ***************************************************************************
+
+int main()
+{
+    char tmpl[] = "/tmp/logscan_check.XXXXXX";
+    if (mkdtemp(tmpl) == nullptr)
+    {
+        perror("mkdtemp");
+        return 2;
+    }
+    directory = tmpl;
+
+    checkSerialLayout(false, "", "serial layout parsed back");
+    checkSerialLayout(true, "", "serial layout with color parsed back");
+    checkSerialLayout(true, "\r", "serial layout with color and CR parsed back");
+    checkSyslogLayout(false, "", "syslog layout with NILVALUE parsed back");
+    checkSyslogLayout(true, "\r", "syslog layout with color and CR parsed back");
+    checkSyslogUptime();
+    checkRejected();
+    checkIndex();
+
+    std::string command = "rm -rf " + directory;
+    if (system(command.c_str()) != 0)
+    {
+        printf("could not remove %s\n", directory.c_str());
+    }
+    return failCount == 0 ? 0 : 1;
+}